@@ -0,0 +1,8 @@
+# g++ --std=c++17 -O2 emulator.cc -o emulator
+# usage: sh bench.sh [cycles]
+# Pong waits for the keyboard forever, so it runs for exactly [cycles].
+cycles=${1:-1000000000}
+for engine in interpreter threaded jit; do
+    echo "$engine:"
+    ./emulator --engine $engine --cycles $cycles ../06/pong/Pong.e.hack
+done
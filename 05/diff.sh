@@ -0,0 +1,17 @@
+# g++ --std=c++17 -O2 emulator.cc -o emulator
+# RAM after N cycles must be the same for every engine
+tmp=$(mktemp -d)
+for cycles in 1 7 1000 1234567 50000001; do
+    for engine in interpreter threaded jit; do
+        ./emulator --engine $engine --cycles $cycles --set 24576=130 --dump $tmp/$engine.ram ../06/pong/Pong.e.hack > /dev/null
+    done
+    diff $tmp/interpreter.ram $tmp/threaded.ram
+    diff $tmp/interpreter.ram $tmp/jit.ram
+done
+
+for engine in interpreter threaded jit; do
+    ./emulator --engine $engine --set 0=4 --dump $tmp/$engine.ram Rect.hack > /dev/null
+done
+diff $tmp/interpreter.ram $tmp/threaded.ram
+diff $tmp/interpreter.ram $tmp/jit.ram
+rm -r $tmp
@@ -0,0 +1,743 @@
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sys/mman.h>
+#include "../06/assembler.h"
+
+static constexpr uint16_t SCREEN = 16384;
+static constexpr uint16_t KBD = 24576;
+
+// One entry per possible 16-bit instruction word, filled once at startup,
+// so executing an instruction never has to pick its bits apart again.
+struct Decoded
+{
+    uint16_t value; // A-instruction constant
+    uint8_t comp;   // a c1 c2 c3 c4 c5 c6
+    uint8_t dest;   // A D M
+    uint8_t jump;   // j1 j2 j3
+    bool isA;
+};
+
+class DecodeTable
+{
+public:
+    DecodeTable()
+        : table(1 << 16)
+    {
+        for (uint32_t word = 0; word < table.size(); word++)
+        {
+            auto &d = table[word];
+            d.isA = (word & 0x8000) == 0;
+            d.value = word;
+            d.comp = (word >> 6) & 0x7F;
+            d.dest = (word >> 3) & 0x7;
+            d.jump = word & 0x7;
+        }
+    }
+
+    const Decoded &operator[](uint16_t word) const
+    {
+        return table[word];
+    }
+
+private:
+    std::vector<Decoded> table;
+};
+
+#if defined(__x86_64__)
+// Translates Hack basic blocks into x86-64 code. A block runs from its
+// start address up to and including the first jump instruction, so the
+// number of Hack instructions it executes is fixed. Inside a block A lives
+// in r8d, D in r9d and the RAM base in rdi; a block returns the next pc,
+// with bit 16 set when its jump was taken. ROM can't be written on Hack,
+// so translated blocks never have to be invalidated.
+class BlockTranslator
+{
+public:
+    using Code = uint32_t (*)(uint16_t *ram, uint16_t *A, uint16_t *D);
+
+    struct Block
+    {
+        Code code = nullptr;
+        uint16_t length = 0;
+    };
+
+    static constexpr size_t MaxBlockLength = 64;
+
+    BlockTranslator() = default;
+    BlockTranslator(const BlockTranslator &) = delete;
+    BlockTranslator &operator=(const BlockTranslator &) = delete;
+
+    ~BlockTranslator()
+    {
+        for (auto chunk : chunks)
+            munmap(chunk, ChunkSize);
+    }
+
+    Block Translate(const std::vector<uint16_t> &rom, uint16_t size, uint16_t start)
+    {
+        code.clear();
+
+        // movzx r8d, word [rsi]; movzx r9d, word [rdx]
+        Emit({0x44, 0x0F, 0xB7, 0x06});
+        Emit({0x44, 0x0F, 0xB7, 0x0A});
+
+        uint16_t pc = start;
+        uint16_t length = 0;
+        uint8_t jump = 0;
+        while (pc < size && length < MaxBlockLength)
+        {
+            auto word = rom[pc++];
+            length++;
+
+            if ((word & 0x8000) == 0)
+            {
+                // mov r8d, imm32
+                Emit({0x41, 0xB8});
+                Emit32(word);
+                continue;
+            }
+
+            jump = word & 0x7;
+            if (jump != 0)
+                Emit({0x45, 0x89, 0xC2}); // mov r10d, r8d: keep the jump target
+
+            EmitALU((word >> 6) & 0x7F);
+            EmitDest((word >> 3) & 0x7);
+
+            if (jump != 0)
+                break;
+        }
+
+        EmitExit(jump, pc);
+
+        Block block;
+        block.code = reinterpret_cast<Code>(Commit());
+        block.length = length;
+        return block;
+    }
+
+private:
+    void Emit(std::initializer_list<uint8_t> bytes)
+    {
+        code.insert(code.end(), bytes);
+    }
+
+    void Emit32(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            code.push_back(value >> (8 * i));
+    }
+
+    void EmitLoadM()
+    {
+        Emit({0x44, 0x89, 0xC1});                   // mov ecx, r8d
+        Emit({0x81, 0xE1, 0xFF, 0x7F, 0x00, 0x00}); // and ecx, 0x7FFF
+    }
+
+    // eax = comp(x=D, y=A/M), straight from the ALU control bits
+    void EmitALU(uint8_t comp)
+    {
+        if (comp & 0b100000)
+            Emit({0x31, 0xC0}); // xor eax, eax
+        else
+            Emit({0x44, 0x89, 0xC8}); // mov eax, r9d
+        if (comp & 0b010000)
+            Emit({0xF7, 0xD0}); // not eax
+
+        if (comp & 0b001000)
+            Emit({0x31, 0xC9}); // xor ecx, ecx
+        else if (comp & 0b1000000)
+        {
+            EmitLoadM();
+            Emit({0x0F, 0xB7, 0x0C, 0x4F}); // movzx ecx, word [rdi+rcx*2]
+        }
+        else
+            Emit({0x44, 0x89, 0xC1}); // mov ecx, r8d
+        if (comp & 0b000100)
+            Emit({0xF7, 0xD1}); // not ecx
+
+        if (comp & 0b000010)
+            Emit({0x01, 0xC8}); // add eax, ecx
+        else
+            Emit({0x21, 0xC8}); // and eax, ecx
+        if (comp & 0b000001)
+            Emit({0xF7, 0xD0}); // not eax
+
+        Emit({0x0F, 0xB7, 0xC0}); // movzx eax, ax
+    }
+
+    void EmitDest(uint8_t dest)
+    {
+        if (dest & 0b001)
+        {
+            EmitLoadM();
+            Emit({0x81, 0xF9});   // cmp ecx, KBD
+            Emit32(KBD);
+            Emit({0x73, 0x04});             // jae over the store
+            Emit({0x66, 0x89, 0x04, 0x4F}); // mov [rdi+rcx*2], ax
+        }
+        if (dest & 0b010)
+            Emit({0x41, 0x89, 0xC1}); // mov r9d, eax
+        if (dest & 0b100)
+            Emit({0x41, 0x89, 0xC0}); // mov r8d, eax
+    }
+
+    void EmitExit(uint8_t jump, uint16_t next)
+    {
+        static constexpr uint8_t jcc[] = {0, 0x7F, 0x74, 0x7D, 0x7C, 0x75, 0x7E, 0};
+
+        if (jump != 0 && jump != 0b111)
+        {
+            Emit({0x66, 0x85, 0xC0}); // test ax, ax
+            Emit({jcc[jump], 7});     // jcc taken
+        }
+
+        if (jump != 0b111)
+        {
+            Emit({0xB8}); // mov eax, next
+            Emit32(next);
+        }
+
+        if (jump != 0 && jump != 0b111)
+            Emit({0xEB, 13}); // jmp exit
+
+        if (jump != 0)
+        {
+            Emit({0x44, 0x89, 0xD0});             // mov eax, r10d
+            Emit({0x25, 0xFF, 0x7F, 0x00, 0x00}); // and eax, 0x7FFF
+            Emit({0x0D, 0x00, 0x00, 0x01, 0x00}); // or eax, 0x10000
+        }
+
+        // mov [rsi], r8w; mov [rdx], r9w; ret
+        Emit({0x66, 0x44, 0x89, 0x06});
+        Emit({0x66, 0x44, 0x89, 0x0A});
+        Emit({0xC3});
+    }
+
+    void *Commit()
+    {
+        if (chunks.empty() || used + code.size() > ChunkSize)
+        {
+            auto chunk = mmap(nullptr, ChunkSize, PROT_READ | PROT_WRITE | PROT_EXEC,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (chunk == MAP_FAILED)
+                throw "cannot map code buffer...\n";
+
+            chunks.push_back(static_cast<uint8_t *>(chunk));
+            used = 0;
+        }
+
+        auto target = chunks.back() + used;
+        std::copy(code.begin(), code.end(), target);
+        used += code.size();
+        return target;
+    }
+
+private:
+    static constexpr size_t ChunkSize = 1 << 20;
+
+    std::vector<uint8_t> code;
+    std::vector<uint8_t *> chunks;
+    size_t used = 0;
+};
+#endif
+
+class Computer
+{
+public:
+    Computer(const std::vector<uint16_t> &program)
+        : rom(1 << 15), ram(1 << 15), size(std::min(program.size(), rom.size()))
+    {
+        std::copy(program.begin(), program.begin() + size, rom.begin());
+    }
+
+    // Executes at most maxCycles instructions and returns how many ran.
+    // Stops early on the "(END) @END 0;JMP" idiom that ends Hack programs,
+    // or when execution runs past the end of the program.
+    uint64_t Run(uint64_t maxCycles)
+    {
+        uint64_t cycles = 0;
+        while (cycles < maxCycles)
+        {
+            const auto &d = decode[rom[pc]];
+            cycles++;
+
+            if (d.isA)
+            {
+                A = d.value;
+                if (++pc >= size)
+                    break;
+                continue;
+            }
+
+            auto out = ALU(d.comp, D, d.comp & 0x40 ? ram[A & 0x7FFF] : A);
+
+            if (d.dest & 0b001)
+                Write(A, out);
+            if (d.dest & 0b010)
+                D = out;
+            auto target = A;
+            if (d.dest & 0b100)
+                A = out;
+
+            auto value = static_cast<int16_t>(out);
+            bool jump = ((d.jump & 0b100) && value < 0) ||
+                        ((d.jump & 0b010) && value == 0) ||
+                        ((d.jump & 0b001) && value > 0);
+
+            if (!jump)
+            {
+                if (++pc >= size)
+                    break;
+                continue;
+            }
+
+            pc = target & 0x7FFF;
+            if (pc >= size || IsHalt(pc))
+                break;
+        }
+
+        return cycles;
+    }
+
+    // Same machine as Run, but the ROM is predecoded once into micro-ops
+    // that point straight at their handler, and execution jumps from one
+    // handler to the next with computed goto. Every comp gets its own
+    // handler for each dest (without jump) and each jump (without dest), so
+    // the handlers contain no decoding at all; the few instructions that
+    // both store and jump, or use a comp outside the Hack mnemonics, go
+    // through a generic handler.
+    uint64_t RunThreaded(uint64_t maxCycles)
+    {
+        uint16_t *ram = this->ram.data();
+        uint16_t A = this->A;
+        uint16_t D = this->D;
+        uint64_t cycles = 0;
+
+#define MEM ram[A & 0x7FFF]
+#define HACK_COMPS(X)                    \
+    X(0b0101010, 0)                      \
+    X(0b0111111, 1)                      \
+    X(0b0111010, -1)                     \
+    X(0b0001100, D)                      \
+    X(0b0110000, A)                      \
+    X(0b1110000, MEM)                    \
+    X(0b0001101, ~D)                     \
+    X(0b0110001, ~A)                     \
+    X(0b1110001, ~MEM)                   \
+    X(0b0001111, -D)                     \
+    X(0b0110011, -A)                     \
+    X(0b1110011, -MEM)                   \
+    X(0b0011111, D + 1)                  \
+    X(0b0110111, A + 1)                  \
+    X(0b1110111, MEM + 1)                \
+    X(0b0001110, D - 1)                  \
+    X(0b0110010, A - 1)                  \
+    X(0b1110010, MEM - 1)                \
+    X(0b0000010, D + A)                  \
+    X(0b1000010, D + MEM)                \
+    X(0b0010011, D - A)                  \
+    X(0b1010011, D - MEM)                \
+    X(0b0000111, A - D)                  \
+    X(0b1000111, MEM - D)                \
+    X(0b0000000, D & A)                  \
+    X(0b1000000, D & MEM)                \
+    X(0b0010101, D | A)                  \
+    X(0b1010101, D | MEM)
+
+#define DISPATCH()                   \
+    do                               \
+    {                                \
+        if (cycles++ == maxCycles)   \
+            goto done;               \
+        goto *op->handler;           \
+    } while (0)
+
+#define JUMP_TO(target)                    \
+    do                                     \
+    {                                      \
+        op = &ops[(target) & 0x7FFF];      \
+        if (op->halt)                      \
+            goto halt;                     \
+        DISPATCH();                        \
+    } while (0)
+
+#define IS_JUMP(jump, out)                                    \
+    ((((jump) & 0b100) && static_cast<int16_t>(out) < 0) ||   \
+     (((jump) & 0b010) && static_cast<int16_t>(out) == 0) ||  \
+     (((jump) & 0b001) && static_cast<int16_t>(out) > 0))
+
+#define DEST_OP(comp, expr, dest)                         \
+    C_##comp##_D##dest:                                   \
+    {                                                     \
+        uint16_t out = (expr);                            \
+        if (((dest) & 0b001) && (A & 0x7FFF) < KBD)       \
+            MEM = out;                                    \
+        if ((dest) & 0b010)                               \
+            D = out;                                      \
+        if ((dest) & 0b100)                               \
+            A = out;                                      \
+        op++;                                             \
+        DISPATCH();                                       \
+    }
+
+#define JUMP_OP(comp, expr, jump)                         \
+    C_##comp##_J##jump:                                   \
+    {                                                     \
+        uint16_t out = (expr);                            \
+        if (IS_JUMP(jump, out))                           \
+            JUMP_TO(A);                                   \
+        op++;                                             \
+        DISPATCH();                                       \
+    }
+
+#define COMP_OPS(comp, expr)                                                          \
+    DEST_OP(comp, expr, 0) DEST_OP(comp, expr, 1) DEST_OP(comp, expr, 2)              \
+    DEST_OP(comp, expr, 3) DEST_OP(comp, expr, 4) DEST_OP(comp, expr, 5)              \
+    DEST_OP(comp, expr, 6) DEST_OP(comp, expr, 7)                                     \
+    JUMP_OP(comp, expr, 1) JUMP_OP(comp, expr, 2) JUMP_OP(comp, expr, 3)              \
+    JUMP_OP(comp, expr, 4) JUMP_OP(comp, expr, 5) JUMP_OP(comp, expr, 6)              \
+    JUMP_OP(comp, expr, 7)
+
+#define COMP_HANDLERS(comp, expr)                                                     \
+    for (int i = 0; i < 8; i++)                                                       \
+        dests[comp][i] = destOps[i];                                                  \
+    for (int i = 1; i < 8; i++)                                                       \
+        jumps[comp][i] = jumpOps[i];
+
+        if (ops.empty())
+        {
+            const void *dests[128][8];
+            const void *jumps[128][8];
+            for (int comp = 0; comp < 128; comp++)
+            {
+                for (int i = 0; i < 8; i++)
+                    dests[comp][i] = jumps[comp][i] = &&generic;
+            }
+
+#define SET_HANDLERS(comp, expr)                                                                            \
+    {                                                                                                       \
+        const void *destOps[] = {&&C_##comp##_D0, &&C_##comp##_D1, &&C_##comp##_D2, &&C_##comp##_D3,        \
+                                 &&C_##comp##_D4, &&C_##comp##_D5, &&C_##comp##_D6, &&C_##comp##_D7};       \
+        const void *jumpOps[] = {nullptr, &&C_##comp##_J1, &&C_##comp##_J2, &&C_##comp##_J3,                \
+                                 &&C_##comp##_J4, &&C_##comp##_J5, &&C_##comp##_J6, &&C_##comp##_J7};       \
+        COMP_HANDLERS(comp, expr)                                                                           \
+    }
+            HACK_COMPS(SET_HANDLERS)
+
+            ops.resize(rom.size() + 1, {&&end, 0, false});
+            for (size_t address = 0; address < size; address++)
+            {
+                auto word = rom[address];
+                const auto &d = decode[word];
+                auto &op = ops[address];
+                op.value = word;
+                op.halt = IsHalt(address);
+                if (d.isA)
+                    op.handler = &&a;
+                else if (d.jump == 0)
+                    op.handler = dests[d.comp][d.dest];
+                else if (d.dest == 0)
+                    op.handler = jumps[d.comp][d.jump];
+                else
+                    op.handler = &&generic;
+            }
+        }
+
+        const MicroOp *op = &ops[pc];
+        DISPATCH();
+
+    a:
+        A = op->value;
+        op++;
+        DISPATCH();
+
+        HACK_COMPS(COMP_OPS)
+
+    generic:
+    {
+        const auto &d = decode[op->value];
+        auto out = ALU(d.comp, D, d.comp & 0x40 ? MEM : A);
+        auto target = A;
+        if ((d.dest & 0b001) && (A & 0x7FFF) < KBD)
+            MEM = out;
+        if (d.dest & 0b010)
+            D = out;
+        if (d.dest & 0b100)
+            A = out;
+        if (IS_JUMP(d.jump, out))
+            JUMP_TO(target);
+        op++;
+        DISPATCH();
+    }
+
+    end:
+    done:
+        cycles--;
+    halt:
+        this->A = A;
+        this->D = D;
+        pc = op - ops.data();
+        return cycles;
+
+#undef SET_HANDLERS
+#undef COMP_HANDLERS
+#undef COMP_OPS
+#undef JUMP_OP
+#undef DEST_OP
+#undef IS_JUMP
+#undef JUMP_TO
+#undef DISPATCH
+#undef HACK_COMPS
+#undef MEM
+    }
+
+#if defined(__x86_64__)
+    // Runs translated blocks; a block that would cross maxCycles is left
+    // to the interpreter so the machine stops at exactly the same point.
+    uint64_t RunJit(uint64_t maxCycles)
+    {
+        if (blocks.empty())
+            blocks.resize(rom.size());
+
+        uint64_t cycles = 0;
+        while (cycles < maxCycles)
+        {
+            auto &block = blocks[pc];
+            if (block.code == nullptr)
+                block = jit.Translate(rom, size, pc);
+
+            if (maxCycles - cycles < block.length)
+                return cycles + Run(maxCycles - cycles);
+
+            auto result = block.code(ram.data(), &A, &D);
+            cycles += block.length;
+            pc = result & 0x7FFF;
+
+            if (pc >= size || ((result & 0x10000) && IsHalt(pc)))
+                break;
+        }
+
+        return cycles;
+    }
+#endif
+
+    uint16_t Read(uint16_t address) const
+    {
+        return ram[address & 0x7FFF];
+    }
+
+    // the keyboard register and addresses above it are read-only
+    void Write(uint16_t address, uint16_t value)
+    {
+        address &= 0x7FFF;
+        if (address < KBD)
+            ram[address] = value;
+    }
+
+    // a jump to this address ends the run, like the halt idiom does
+    void SetStop(int address)
+    {
+        stop = address;
+    }
+
+    void SetKeyboard(uint16_t key)
+    {
+        ram[KBD] = key;
+    }
+
+    void DumpRAM(std::ostream &output) const
+    {
+        for (auto value : ram)
+            output << static_cast<int16_t>(value) << "\n";
+    }
+
+    // 512x256 screen as a plain PBM image
+    void DumpScreen(std::ostream &output) const
+    {
+        output << "P1\n512 256\n";
+        for (int row = 0; row < 256; row++)
+        {
+            for (int col = 0; col < 512; col++)
+                output << ((ram[SCREEN + row * 32 + col / 16] >> (col % 16)) & 1);
+            output << "\n";
+        }
+    }
+
+private:
+    static uint16_t ALU(uint8_t comp, uint16_t x, uint16_t y)
+    {
+        if (comp & 0b100000)
+            x = 0;
+        if (comp & 0b010000)
+            x = ~x;
+        if (comp & 0b001000)
+            y = 0;
+        if (comp & 0b000100)
+            y = ~y;
+
+        uint16_t out = comp & 0b000010 ? x + y : x & y;
+        if (comp & 0b000001)
+            out = ~out;
+
+        return out;
+    }
+
+    bool IsHalt(uint16_t target) const
+    {
+        if (target == stop)
+            return true;
+
+        if (rom[target] != target || target == 0x7FFF)
+            return false;
+
+        auto next = rom[target + 1];
+        return (next & 0xE000) == 0xE000 && (next & 0x3F) == 0b000111;
+    }
+
+private:
+    struct MicroOp
+    {
+        const void *handler;
+        uint16_t value;
+        bool halt; // start of the "(END) @END 0;JMP" loop
+    };
+
+    DecodeTable decode;
+    std::vector<MicroOp> ops;
+#if defined(__x86_64__)
+    BlockTranslator jit;
+    std::vector<BlockTranslator::Block> blocks;
+#endif
+    std::vector<uint16_t> rom;
+    std::vector<uint16_t> ram;
+    uint16_t size;
+    uint16_t A = 0;
+    uint16_t D = 0;
+    uint16_t pc = 0;
+    int stop = -1;
+};
+
+// .hack text, a packed .bin image or .asm source
+std::vector<uint16_t> LoadProgram(const std::filesystem::path &filename)
+{
+    std::ifstream input(filename, std::ios::binary);
+    std::stringstream content;
+    content << input.rdbuf();
+    auto text = content.str();
+
+    if (filename.extension() == ".asm")
+        return Assemble(text);
+
+    std::vector<uint16_t> program;
+    if (filename.extension() == ".bin")
+    {
+        for (size_t i = 0; i + 1 < text.size(); i += 2)
+            program.push_back(static_cast<uint8_t>(text[i]) | static_cast<uint8_t>(text[i + 1]) << 8);
+
+        return program;
+    }
+
+    std::string line;
+    while (std::getline(content, line))
+    {
+        if (line.size() >= 16)
+            program.push_back(std::stoi(line.substr(0, 16), nullptr, 2));
+    }
+
+    return program;
+}
+
+// g++ --std=c++17 -O2 emulator.cc -o emulator
+int main(int argc, char *argv[])
+{
+    std::string input;
+    std::string engine = "threaded";
+    uint64_t maxCycles = UINT64_MAX;
+    std::vector<std::pair<int, int>> sets;
+    std::vector<int> prints;
+    int stop = -1;
+    std::string dumpFile;
+    std::string screenFile;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--engine" && i + 1 < argc)
+            engine = argv[++i];
+        else if (arg == "--cycles" && i + 1 < argc)
+            maxCycles = std::stoull(argv[++i]);
+        else if (arg == "--set" && i + 1 < argc)
+        {
+            std::string assignment(argv[++i]);
+            auto equal = assignment.find('=');
+            sets.emplace_back(std::stoi(assignment.substr(0, equal)), std::stoi(assignment.substr(equal + 1)));
+        }
+        else if (arg == "--print" && i + 1 < argc)
+            prints.push_back(std::stoi(argv[++i]));
+        else if (arg == "--stop" && i + 1 < argc)
+            stop = std::stoi(argv[++i]);
+        else if (arg == "--dump" && i + 1 < argc)
+            dumpFile = argv[++i];
+        else if (arg == "--screen" && i + 1 < argc)
+            screenFile = argv[++i];
+        else if (input.empty())
+            input = arg;
+        else
+        {
+            input.clear();
+            break;
+        }
+    }
+
+    if (input.empty())
+    {
+        std::cout << "Usage: /bin [--engine threaded|interpreter|jit] [--cycles N] [--stop ADDR] [--set ADDR=VALUE]... [--print ADDR]... "
+                     "[--dump ram.txt] [--screen screen.pbm] /path/to/program.hack\n";
+        return 0;
+    }
+
+    Computer computer(LoadProgram(input));
+    computer.SetStop(stop);
+    for (const auto &[address, value] : sets)
+    {
+        if (address == KBD)
+            computer.SetKeyboard(value);
+        else
+            computer.Write(address, value);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t cycles = 0;
+    if (engine == "interpreter")
+        cycles = computer.Run(maxCycles);
+#if defined(__x86_64__)
+    else if (engine == "jit")
+        cycles = computer.RunJit(maxCycles);
+#endif
+    else
+        cycles = computer.RunThreaded(maxCycles);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << cycles << " instructions in " << elapsed.count() << " s, "
+              << cycles / elapsed.count() / 1e6 << " MIPS\n";
+
+    for (auto address : prints)
+        std::cout << "RAM[" << address << "] = " << static_cast<int16_t>(computer.Read(address)) << "\n";
+
+    if (!dumpFile.empty())
+    {
+        std::ofstream dump(dumpFile);
+        computer.DumpRAM(dump);
+    }
+
+    if (!screenFile.empty())
+    {
+        std::ofstream screen(screenFile);
+        computer.DumpScreen(screen);
+    }
+}
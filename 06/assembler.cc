@@ -1,378 +1,180 @@
 #include <iostream>
 #include <filesystem>
 #include <fstream>
-#include <bitset>
-#include <map>
-#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include "assembler.h"
 
-enum class InstructionType
+void AppendText(std::string &output, uint16_t code)
 {
-    A_INSTRUCTION,
-    C_INSTRUCTION,
-    L_INSTRUCTION,
-};
+    for (int bit = 15; bit >= 0; bit--)
+        output.push_back('0' + ((code >> bit) & 1));
+    output.push_back('\n');
+}
 
-class Parser
+// packed little-endian 16-bit words
+void AppendBinary(std::string &output, uint16_t code)
 {
-public:
-    Parser(const std::string &filename)
-        : inputstream(filename) {}
-
-    ~Parser()
-    {
-        inputstream.close();
-    }
+    output.push_back(code & 0xFF);
+    output.push_back(code >> 8);
+}
 
-    bool HasMoreLines()
-    {
-        return inputstream.peek() != EOF;
-    }
+// stdin to stdout, holding back only what unresolved references require;
+// with variables that is everything after the first one is referenced
+void AssembleStream(bool binary)
+{
+    std::string output;
+    StreamAssembler assembler([&output, binary](uint16_t code) {
+        if (binary)
+            AppendBinary(output, code);
+        else
+            AppendText(output, code);
 
-    int Advance()
-    {
-        while (std::getline(inputstream, instruction))
+        if (output.size() >= 1 << 16)
         {
-            boost::trim(instruction);
-            if (instruction.empty() || instruction.substr(0, 2) == "//")
-                continue;
-
-            auto pos = instruction.find_first_of("//");
-            if (pos != std::string::npos)
-            {
-                instruction = instruction.substr(0, pos);
-                boost::trim(instruction);
-            }
-
-            break;
+            std::cout.write(output.data(), output.size());
+            output.clear();
         }
+    });
 
-        switch (GetInstructionType())
-        {
-        case InstructionType::A_INSTRUCTION:
-            symbol = instruction.substr(1, instruction.size() - 1);
-            lineno++;
-            break;
-        case InstructionType::L_INSTRUCTION:
-            symbol = instruction.substr(1, instruction.size() - 2);
-            break;
-        case InstructionType::C_INSTRUCTION:
-        {
-            lineno++;
-
-            // dest=comp;jump
-            std::vector<std::string> tokens;
-            boost::split(tokens, instruction, boost::is_any_of("=;"));
-            auto equalPos = instruction.find('=');
-            if (equalPos != std::string::npos)
-            {
-                dest = tokens[0];
-                comp = tokens[1];
-            }
-            else
-            {
-                dest = "";
-                comp = tokens[0];
-            }
-
-            auto semicolonPos = instruction.find(';');
-            if (semicolonPos != std::string::npos)
-                jump = tokens.back();
-            else
-                jump = "";
-
-            break;
-        }
-        default:
-            throw "should not reach here...";
-        }
-
-        return lineno;
-    }
-
-    InstructionType GetInstructionType() const
-    {
-        if (instruction[0] == '@')
-            return InstructionType::A_INSTRUCTION;
-
-        if (instruction[0] == '(')
-            return InstructionType::L_INSTRUCTION;
-
-        return InstructionType::C_INSTRUCTION;
-    }
-
-    std::string Symbol() const
-    {
-        return symbol;
-    }
-
-    std::string Dest() const
+    std::string buffer;
+    std::vector<char> block(1 << 16);
+    while (std::cin.read(block.data(), block.size()) || std::cin.gcount() > 0)
     {
-        return dest;
-    }
+        buffer.append(block.data(), std::cin.gcount());
 
-    std::string Comp() const
-    {
-        return comp;
-    }
+        auto end = buffer.rfind('\n');
+        if (end == std::string::npos)
+            continue;
 
-    std::string Jump() const
-    {
-        return jump;
+        assembler.Feed(std::string_view(buffer).substr(0, end + 1));
+        buffer.erase(0, end + 1);
     }
 
-private:
-    std::ifstream inputstream;
-    std::string instruction;
-    std::string symbol;
-    std::string dest;
-    std::string comp;
-    std::string jump;
-    int lineno = -1;
-};
+    assembler.Feed(buffer);
+    assembler.Finish();
+    std::cout.write(output.data(), output.size());
+}
 
-class Code
+// Encoding alone, without parsing or output: every comp;jump pair through
+// Code::Comp/Code::Jump, then through a linear scan over the same mnemonics,
+// which is what the string compare chain before the tables amounted to.
+void BenchEncode(int rounds)
 {
-public:
-    Code() = delete;
-
-    static std::string Dest(const std::string &code)
+    std::vector<std::string_view> comps = {"0", "1", "-1", "D", "A", "M", "!D", "!A", "!M", "-D",
+                                           "-A", "-M", "D+1", "A+1", "M+1", "D-1", "A-1", "M-1", "D+A", "D+M",
+                                           "D-A", "D-M", "A-D", "M-D", "D&A", "D&M", "D|A", "D|M"};
+    std::vector<std::string_view> jumps = {"", "JGT", "JEQ", "JGE", "JLT", "JNE", "JLE", "JMP"};
+    std::vector<std::pair<std::string_view, std::string_view>> inputs;
+    for (auto comp : comps)
     {
-        std::string dest(3, '0');
-        if (code.find('A') != std::string::npos)
-            dest[0] = '1';
-        if (code.find('D') != std::string::npos)
-            dest[1] = '1';
-        if (code.find('M') != std::string::npos)
-            dest[2] = '1';
-
-        return dest;
+        for (auto jump : jumps)
+            inputs.emplace_back(comp, jump);
     }
 
-    static std::string Comp(const std::string &code)
-    {
-        if (code == "0")
-            return "0101010";
-        else if (code == "1")
-            return "0111111";
-        else if (code == "-1")
-            return "0111010";
-        else if (code == "D")
-            return "0001100";
-        else if (code == "A")
-            return "0110000";
-        else if (code == "M")
-            return "1110000";
-        else if (code == "!D")
-            return "0001101";
-        else if (code == "!A")
-            return "0110001";
-        else if (code == "!M")
-            return "1110001";
-        else if (code == "-D")
-            return "0001111";
-        else if (code == "-A")
-            return "0110011";
-        else if (code == "-M")
-            return "1110011";
-        else if (code == "D+1")
-            return "0011111";
-        else if (code == "A+1")
-            return "0110111";
-        else if (code == "M+1")
-            return "1110111";
-        else if (code == "D-1")
-            return "0001110";
-        else if (code == "A-1")
-            return "0110010";
-        else if (code == "M-1")
-            return "1110010";
-        else if (code == "D+A")
-            return "0000010";
-        else if (code == "D+M")
-            return "1000010";
-        else if (code == "D-A")
-            return "0010011";
-        else if (code == "D-M")
-            return "1010011";
-        else if (code == "A-D")
-            return "0000111";
-        else if (code == "M-D")
-            return "1000111";
-        else if (code == "D&A")
-            return "0000000";
-        else if (code == "D&M")
-            return "1000000";
-        else if (code == "D|A")
-            return "0010101";
-        else if (code == "D|M")
-            return "1010101";
-        else
-            throw "should not reach here...\n";
-    }
+    std::vector<Mnemonic> compList, jumpList;
+    for (auto comp : comps)
+        compList.push_back({comp, Code::Comp(comp)});
+    for (auto jump : jumps)
+        jumpList.push_back({jump, Code::Jump(jump)});
 
-    static std::string Jump(const std::string &code)
+    auto scan = [](const std::vector<Mnemonic> &list, std::string_view name) -> uint16_t
     {
-        if (code == "")
-            return "000";
-        else if (code == "JGT")
-            return "001";
-        else if (code == "JEQ")
-            return "010";
-        else if (code == "JGE")
-            return "011";
-        else if (code == "JLT")
-            return "100";
-        else if (code == "JNE")
-            return "101";
-        else if (code == "JLE")
-            return "110";
-        else if (code == "JMP")
-            return "111";
-        else
-            throw "should not reach here...\n";
-    }
-};
-
-class SymbolTable
-{
-public:
-    SymbolTable() = default;
+        for (const auto &m : list)
+        {
+            if (m.name == name)
+                return m.bits;
+        }
+        throw "should not reach here...\n";
+    };
 
-    void AddEntry(const std::string &symbol, int address)
+    auto measure = [&](const char *name, auto encode)
     {
-        table[symbol] = address;
-    }
+        size_t count = static_cast<size_t>(rounds) * inputs.size();
+        uint32_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto &[comp, jump] = inputs[i % inputs.size()];
+            checksum += encode(comp, jump);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << count << " encodings in " << elapsed.count() << " s, "
+                  << count / elapsed.count() / 1e6 << " M/s (checksum " << checksum << ")\n";
+    };
+
+    measure("tables", [](std::string_view comp, std::string_view jump)
+            { return static_cast<uint16_t>(Code::Comp(comp) << 6 | Code::Jump(jump)); });
+    measure("linear scan", [&](std::string_view comp, std::string_view jump)
+            { return static_cast<uint16_t>(scan(compList, comp) << 6 | scan(jumpList, jump)); });
+}
 
-    bool Contains(const std::string &symbol) const
-    {
-        return table.find(symbol) != table.end();
+// g++ --std=c++17 -g -O0 -pthread assembler.cc -o assembler
+int main(int argc, char *argv[])
+{
+    std::string input;
+    bool twoPass = false;
+    bool binary = false;
+    int jobs = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--two-pass")
+            twoPass = true;
+        else if (arg == "--jobs" && i + 1 < argc)
+            jobs = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--binary")
+            binary = true;
+        else if (arg == "--bench-encode" && i + 1 < argc)
+        {
+            BenchEncode(std::max(1, std::stoi(argv[++i])));
+            return 0;
+        }
+        else if (input.empty())
+            input = arg;
+        else
+        {
+            input.clear();
+            break;
+        }
     }
 
-    int GetAddress(const std::string &symbol) const
+    if (input.empty())
     {
-        if (Contains(symbol))
-            return table.at(symbol);
-
-        return -1;
+        std::cout << "Usage: /bin [--two-pass] [--jobs N] [--binary] [--bench-encode ROUNDS] /path/to/input/file|-\n"
+                     "  - streams stdin to stdout; output after the first reference to a variable\n"
+                     "    (a symbol never defined as a label) is held until the end of the input\n";
+        return 0;
     }
 
-private:
-    std::map<std::string, int> table;
-};
-
-// g++ --std=c++17 -g -O0 assembler.cc -o assembler
-int main(int argc, char *argv[])
-{
-    if (argc != 2)
+    if (input == "-")
     {
-        std::cout << "Usage: /bin /path/to/input/file\n";
+        std::ios::sync_with_stdio(false);
+        AssembleStream(binary);
         return 0;
     }
 
-    SymbolTable symbolTable;
-    { // Build symbol table
+    MappedFile file(input);
+    std::vector<uint16_t> codes;
+    if (twoPass)
+        codes = AssembleTwoPass(file.Content());
+    else if (jobs > 1)
+        codes = AssembleParallel(file.Content(), jobs);
+    else
+        codes = Assemble(file.Content());
 
-        symbolTable.AddEntry("R0", 0);
-        symbolTable.AddEntry("R1", 1);
-        symbolTable.AddEntry("R2", 2);
-        symbolTable.AddEntry("R3", 3);
-        symbolTable.AddEntry("R4", 4);
-        symbolTable.AddEntry("R5", 5);
-        symbolTable.AddEntry("R6", 6);
-        symbolTable.AddEntry("R7", 7);
-        symbolTable.AddEntry("R8", 8);
-        symbolTable.AddEntry("R9", 9);
-        symbolTable.AddEntry("R10", 10);
-        symbolTable.AddEntry("R11", 11);
-        symbolTable.AddEntry("R12", 12);
-        symbolTable.AddEntry("R13", 13);
-        symbolTable.AddEntry("R14", 14);
-        symbolTable.AddEntry("R15", 15);
+    std::filesystem::path input_filename(input);
+    std::filesystem::path output_filename = input_filename.replace_extension(binary ? ".bin" : ".hack");
 
-        symbolTable.AddEntry("SP", 0);
-        symbolTable.AddEntry("LCL", 1);
-        symbolTable.AddEntry("ARG", 2);
-        symbolTable.AddEntry("THIS", 3);
-        symbolTable.AddEntry("THAT", 4);
-
-        symbolTable.AddEntry("SCREEN", 16384);
-        symbolTable.AddEntry("KBD", 24576);
-
-        Parser parser(argv[1]);
-        while (parser.HasMoreLines())
-        {
-            int lineno = parser.Advance();
-            auto type = parser.GetInstructionType();
-            switch (type)
-            {
-            case InstructionType::A_INSTRUCTION:
-                break;
-            case InstructionType::L_INSTRUCTION:
-            {
-                auto symbol = parser.Symbol();
-                if (!symbolTable.Contains(symbol))
-                    symbolTable.AddEntry(symbol, lineno + 1);
-
-                break;
-            }
-            case InstructionType::C_INSTRUCTION:
-                break;
-
-            default:
-                break;
-            }
-        }
-    }
-
-    std::vector<std::string> codes;
-
-    int var_address = 16;
-    Parser parser(argv[1]);
-    while (parser.HasMoreLines())
+    std::string output;
+    output.reserve(codes.size() * (binary ? 2 : 17));
+    for (auto code : codes)
     {
-        parser.Advance();
-        auto type = parser.GetInstructionType();
-        switch (type)
-        {
-        case InstructionType::A_INSTRUCTION:
-        {
-            auto symbol = parser.Symbol();
-            uint16_t address = 0;
-            if (!isdigit(symbol[0]))
-            {
-                if (!symbolTable.Contains(symbol))
-                {
-                    symbolTable.AddEntry(symbol, var_address);
-                    var_address++;
-                }
-
-                address = symbolTable.GetAddress(symbol);
-            }
-            else
-                address = std::stoi(symbol);
-
-            auto code = std::bitset<16>(address).to_string();
-            codes.push_back(code);
-            break;
-        }
-        case InstructionType::L_INSTRUCTION:
-            break;
-        case InstructionType::C_INSTRUCTION:
-            codes.push_back("111" +
-                            Code::Comp(parser.Comp()) +
-                            Code::Dest(parser.Dest()) +
-                            Code::Jump(parser.Jump()));
-            break;
-
-        default:
-            break;
-        }
+        if (binary)
+            AppendBinary(output, code);
+        else
+            AppendText(output, code);
     }
 
-    std::filesystem::path input_filename(argv[1]);
-    std::filesystem::path output_filename = input_filename.replace_extension(".hack");
-
-    std::ofstream output_file(output_filename);
-    std::ostream_iterator<std::string> output_iterator(output_file, "\n");
-    std::copy(codes.begin(), codes.end(), output_iterator);
+    std::ofstream output_file(output_filename, std::ios::binary);
+    output_file.write(output.data(), output.size());
 }
@@ -0,0 +1,937 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class InstructionType
+{
+    A_INSTRUCTION,
+    C_INSTRUCTION,
+    L_INSTRUCTION,
+};
+
+class MappedFile
+{
+public:
+    MappedFile(const std::string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw "cannot open input file...\n";
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            size = st.st_size;
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+
+        if (data == MAP_FAILED)
+            throw "cannot map input file...\n";
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        if (data != nullptr)
+            munmap(data, size);
+    }
+
+    std::string_view Content() const
+    {
+        return std::string_view(static_cast<const char *>(data), size);
+    }
+
+private:
+    void *data = nullptr;
+    size_t size = 0;
+};
+
+class Parser
+{
+public:
+    // Every field handed out by the parser is a view into the source,
+    // so nothing is copied per instruction.
+    Parser(std::string_view source)
+        : buffer(source) {}
+
+    bool HasMoreLines()
+    {
+        while (next.empty() && pos < buffer.size())
+        {
+            auto end = buffer.find('\n', pos);
+            if (end == std::string_view::npos)
+                end = buffer.size();
+
+            auto line = buffer.substr(pos, end - pos);
+            pos = end + 1;
+
+            auto comment = line.find('/');
+            if (comment != std::string_view::npos)
+                line = line.substr(0, comment);
+
+            next = Trim(line);
+        }
+
+        return !next.empty();
+    }
+
+    int Advance()
+    {
+        if (!HasMoreLines())
+            throw "no more instructions...\n";
+
+        instruction = next;
+        next = {};
+
+        switch (GetInstructionType())
+        {
+        case InstructionType::A_INSTRUCTION:
+            symbol = instruction.substr(1);
+            lineno++;
+            break;
+        case InstructionType::L_INSTRUCTION:
+            symbol = instruction.substr(1, instruction.size() - 2);
+            break;
+        case InstructionType::C_INSTRUCTION:
+        {
+            lineno++;
+
+            // dest=comp;jump
+            auto equalPos = instruction.find('=');
+            auto semicolonPos = instruction.find(';');
+            size_t compPos = 0;
+            if (equalPos != std::string_view::npos)
+            {
+                dest = instruction.substr(0, equalPos);
+                compPos = equalPos + 1;
+            }
+            else
+                dest = {};
+
+            comp = instruction.substr(compPos, semicolonPos - compPos);
+            if (semicolonPos != std::string_view::npos)
+                jump = instruction.substr(semicolonPos + 1);
+            else
+                jump = {};
+
+            break;
+        }
+        default:
+            throw "should not reach here...";
+        }
+
+        return lineno;
+    }
+
+    InstructionType GetInstructionType() const
+    {
+        if (instruction[0] == '@')
+            return InstructionType::A_INSTRUCTION;
+
+        if (instruction[0] == '(')
+            return InstructionType::L_INSTRUCTION;
+
+        return InstructionType::C_INSTRUCTION;
+    }
+
+    std::string_view Symbol() const
+    {
+        return symbol;
+    }
+
+    std::string_view Dest() const
+    {
+        return dest;
+    }
+
+    std::string_view Comp() const
+    {
+        return comp;
+    }
+
+    std::string_view Jump() const
+    {
+        return jump;
+    }
+
+private:
+    static std::string_view Trim(std::string_view s)
+    {
+        while (!s.empty() && isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        while (!s.empty() && isspace(static_cast<unsigned char>(s.back())))
+            s.remove_suffix(1);
+
+        return s;
+    }
+
+private:
+    std::string_view buffer;
+    size_t pos = 0;
+    std::string_view next;
+    std::string_view instruction;
+    std::string_view symbol;
+    std::string_view dest;
+    std::string_view comp;
+    std::string_view jump;
+    int lineno = -1;
+};
+
+struct Mnemonic
+{
+    std::string_view name;
+    uint16_t bits;
+};
+
+// Perfect hash over mnemonics of at most 3 characters. The characters are
+// packed into an integer key and a multiplier that spreads all keys into
+// distinct slots is searched for at compile time, so a lookup is one
+// multiply, one shift and one integer compare.
+template <size_t N, size_t Bits>
+class MnemonicTable
+{
+public:
+    constexpr MnemonicTable(const Mnemonic (&mnemonics)[N])
+        : multiplier(FindMultiplier(mnemonics))
+    {
+        for (const auto &m : mnemonics)
+            slots[Slot(Key(m.name), multiplier)] = {Key(m.name), m.bits, true};
+    }
+
+    constexpr int Find(std::string_view name) const
+    {
+        auto key = Key(name);
+        const auto &slot = slots[Slot(key, multiplier)];
+        if (slot.used && slot.key == key)
+            return slot.bits;
+
+        return -1;
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t key = 0;
+        uint16_t bits = 0;
+        bool used = false;
+    };
+
+    static constexpr uint32_t Key(std::string_view name)
+    {
+        if (name.size() > 3)
+            return UINT32_MAX;
+
+        uint32_t key = 0;
+        for (size_t i = 0; i < name.size(); i++)
+            key |= static_cast<uint32_t>(static_cast<unsigned char>(name[i])) << (8 * i);
+
+        return key;
+    }
+
+    static constexpr size_t Slot(uint32_t key, uint32_t multiplier)
+    {
+        return (key * multiplier) >> (32 - Bits);
+    }
+
+    static constexpr uint32_t FindMultiplier(const Mnemonic (&mnemonics)[N])
+    {
+        for (uint32_t multiplier = 0x9E3779B1u;; multiplier += 2)
+        {
+            bool used[1 << Bits] = {};
+            bool collision = false;
+            for (const auto &m : mnemonics)
+            {
+                auto slot = Slot(Key(m.name), multiplier);
+                collision = collision || used[slot];
+                used[slot] = true;
+            }
+
+            if (!collision)
+                return multiplier;
+        }
+    }
+
+    uint32_t multiplier;
+    Entry slots[1 << Bits] = {};
+};
+
+class Code
+{
+public:
+    Code() = delete;
+
+    static uint16_t Dest(std::string_view code)
+    {
+        uint16_t dest = 0;
+        for (auto c : code)
+        {
+            if (c == 'A')
+                dest |= 0b100;
+            else if (c == 'D')
+                dest |= 0b010;
+            else if (c == 'M')
+                dest |= 0b001;
+        }
+
+        return dest;
+    }
+
+    static uint16_t Comp(std::string_view code)
+    {
+        auto comp = compTable.Find(code);
+        if (comp < 0)
+            throw "should not reach here...\n";
+
+        return comp;
+    }
+
+    static uint16_t Jump(std::string_view code)
+    {
+        auto jump = jumpTable.Find(code);
+        if (jump < 0)
+            throw "should not reach here...\n";
+
+        return jump;
+    }
+
+private:
+    static constexpr Mnemonic comps[] = {
+        {"0", 0b0101010},
+        {"1", 0b0111111},
+        {"-1", 0b0111010},
+        {"D", 0b0001100},
+        {"A", 0b0110000},
+        {"M", 0b1110000},
+        {"!D", 0b0001101},
+        {"!A", 0b0110001},
+        {"!M", 0b1110001},
+        {"-D", 0b0001111},
+        {"-A", 0b0110011},
+        {"-M", 0b1110011},
+        {"D+1", 0b0011111},
+        {"A+1", 0b0110111},
+        {"M+1", 0b1110111},
+        {"D-1", 0b0001110},
+        {"A-1", 0b0110010},
+        {"M-1", 0b1110010},
+        {"D+A", 0b0000010},
+        {"D+M", 0b1000010},
+        {"D-A", 0b0010011},
+        {"D-M", 0b1010011},
+        {"A-D", 0b0000111},
+        {"M-D", 0b1000111},
+        {"D&A", 0b0000000},
+        {"D&M", 0b1000000},
+        {"D|A", 0b0010101},
+        {"D|M", 0b1010101},
+    };
+
+    static constexpr Mnemonic jumps[] = {
+        {"", 0b000},
+        {"JGT", 0b001},
+        {"JEQ", 0b010},
+        {"JGE", 0b011},
+        {"JLT", 0b100},
+        {"JNE", 0b101},
+        {"JLE", 0b110},
+        {"JMP", 0b111},
+    };
+
+    static constexpr MnemonicTable<std::size(comps), 7> compTable{comps};
+    static constexpr MnemonicTable<std::size(jumps), 4> jumpTable{jumps};
+};
+
+// Open-addressing hash table. Every symbol is interned once and gets a
+// stable id, so the assembler resolves a reference with a single lookup
+// and afterwards only deals with ids. Unresolved symbols have address -1.
+class SymbolTable
+{
+public:
+    SymbolTable()
+        : slots(1024, -1) {}
+
+    int Intern(std::string_view symbol)
+    {
+        auto hash = Hash(symbol);
+        auto mask = slots.size() - 1;
+        for (auto i = hash & mask;; i = (i + 1) & mask)
+        {
+            auto id = slots[i];
+            if (id < 0)
+            {
+                id = entries.size();
+                slots[i] = id;
+                entries.push_back({hash, static_cast<uint32_t>(names.size()), static_cast<uint32_t>(symbol.size()), -1});
+                names.append(symbol);
+
+                if (entries.size() * 2 > slots.size())
+                    Grow();
+
+                return id;
+            }
+
+            if (entries[id].hash == hash && Name(id) == symbol)
+                return id;
+        }
+    }
+
+    int Find(std::string_view symbol) const
+    {
+        auto hash = Hash(symbol);
+        auto mask = slots.size() - 1;
+        for (auto i = hash & mask;; i = (i + 1) & mask)
+        {
+            auto id = slots[i];
+            if (id < 0 || (entries[id].hash == hash && Name(id) == symbol))
+                return id;
+        }
+    }
+
+    void AddEntry(std::string_view symbol, int address)
+    {
+        SetAddress(Intern(symbol), address);
+    }
+
+    bool Contains(std::string_view symbol) const
+    {
+        return GetAddress(symbol) >= 0;
+    }
+
+    int GetAddress(std::string_view symbol) const
+    {
+        auto id = Find(symbol);
+        if (id < 0)
+            return -1;
+
+        return GetAddress(id);
+    }
+
+    int GetAddress(int id) const
+    {
+        return entries[id].address;
+    }
+
+    void SetAddress(int id, int address)
+    {
+        entries[id].address = address;
+    }
+
+    int Size() const
+    {
+        return entries.size();
+    }
+
+    std::string_view Name(int id) const
+    {
+        return std::string_view(names).substr(entries[id].offset, entries[id].length);
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t hash;
+        uint32_t offset;
+        uint32_t length;
+        int address;
+    };
+
+    static uint32_t Hash(std::string_view symbol)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (auto c : symbol)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    void Grow()
+    {
+        slots.assign(slots.size() * 2, -1);
+        auto mask = slots.size() - 1;
+        for (size_t id = 0; id < entries.size(); id++)
+        {
+            auto i = entries[id].hash & mask;
+            while (slots[i] >= 0)
+                i = (i + 1) & mask;
+
+            slots[i] = id;
+        }
+    }
+
+private:
+    std::vector<int> slots;
+    std::vector<Entry> entries;
+    std::string names;
+};
+
+inline void AddPredefinedSymbols(SymbolTable &symbolTable)
+{
+    symbolTable.AddEntry("R0", 0);
+    symbolTable.AddEntry("R1", 1);
+    symbolTable.AddEntry("R2", 2);
+    symbolTable.AddEntry("R3", 3);
+    symbolTable.AddEntry("R4", 4);
+    symbolTable.AddEntry("R5", 5);
+    symbolTable.AddEntry("R6", 6);
+    symbolTable.AddEntry("R7", 7);
+    symbolTable.AddEntry("R8", 8);
+    symbolTable.AddEntry("R9", 9);
+    symbolTable.AddEntry("R10", 10);
+    symbolTable.AddEntry("R11", 11);
+    symbolTable.AddEntry("R12", 12);
+    symbolTable.AddEntry("R13", 13);
+    symbolTable.AddEntry("R14", 14);
+    symbolTable.AddEntry("R15", 15);
+
+    symbolTable.AddEntry("SP", 0);
+    symbolTable.AddEntry("LCL", 1);
+    symbolTable.AddEntry("ARG", 2);
+    symbolTable.AddEntry("THIS", 3);
+    symbolTable.AddEntry("THAT", 4);
+
+    symbolTable.AddEntry("SCREEN", 16384);
+    symbolTable.AddEntry("KBD", 24576);
+}
+
+inline uint16_t ParseNumber(std::string_view symbol)
+{
+    uint16_t value = 0;
+    std::from_chars(symbol.data(), symbol.data() + symbol.size(), value);
+    return value;
+}
+
+inline uint16_t EncodeC(const Parser &parser)
+{
+    return 0b111 << 13 |
+           Code::Comp(parser.Comp()) << 6 |
+           Code::Dest(parser.Dest()) << 3 |
+           Code::Jump(parser.Jump());
+}
+
+inline std::vector<uint16_t> AssembleTwoPass(std::string_view source)
+{
+    SymbolTable symbolTable;
+    AddPredefinedSymbols(symbolTable);
+
+    { // Build symbol table
+        Parser parser(source);
+        while (parser.HasMoreLines())
+        {
+            int lineno = parser.Advance();
+            if (parser.GetInstructionType() == InstructionType::L_INSTRUCTION)
+            {
+                auto id = symbolTable.Intern(parser.Symbol());
+                if (symbolTable.GetAddress(id) < 0)
+                    symbolTable.SetAddress(id, lineno + 1);
+            }
+        }
+    }
+
+    std::vector<uint16_t> codes;
+
+    int var_address = 16;
+    Parser parser(source);
+    while (parser.HasMoreLines())
+    {
+        parser.Advance();
+        auto type = parser.GetInstructionType();
+        switch (type)
+        {
+        case InstructionType::A_INSTRUCTION:
+        {
+            auto symbol = parser.Symbol();
+            uint16_t address = 0;
+            if (!isdigit(symbol[0]))
+            {
+                auto id = symbolTable.Intern(symbol);
+                if (symbolTable.GetAddress(id) < 0)
+                {
+                    symbolTable.SetAddress(id, var_address);
+                    var_address++;
+                }
+
+                address = symbolTable.GetAddress(id);
+            }
+            else
+                address = ParseNumber(symbol);
+
+            codes.push_back(address);
+            break;
+        }
+        case InstructionType::L_INSTRUCTION:
+            break;
+        case InstructionType::C_INSTRUCTION:
+            codes.push_back(EncodeC(parser));
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return codes;
+}
+
+// Reads the input only once. A symbol that is not known yet when it is
+// referenced is recorded and patched after the whole file has been seen:
+// either it turns out to be a label defined later, or it is a variable
+// and gets the next free address in first-use order, same as two-pass.
+inline std::vector<uint16_t> AssembleOnePass(std::string_view source)
+{
+    SymbolTable symbolTable;
+    AddPredefinedSymbols(symbolTable);
+
+    std::vector<uint16_t> codes;
+    std::vector<std::pair<size_t, int>> unresolved;
+
+    Parser parser(source);
+    while (parser.HasMoreLines())
+    {
+        parser.Advance();
+        auto type = parser.GetInstructionType();
+        switch (type)
+        {
+        case InstructionType::A_INSTRUCTION:
+        {
+            auto symbol = parser.Symbol();
+            uint16_t address = 0;
+            if (!isdigit(symbol[0]))
+            {
+                auto id = symbolTable.Intern(symbol);
+                if (symbolTable.GetAddress(id) < 0)
+                {
+                    unresolved.emplace_back(codes.size(), id);
+                    codes.push_back(0);
+                    break;
+                }
+
+                address = symbolTable.GetAddress(id);
+            }
+            else
+                address = ParseNumber(symbol);
+
+            codes.push_back(address);
+            break;
+        }
+        case InstructionType::L_INSTRUCTION:
+        {
+            auto id = symbolTable.Intern(parser.Symbol());
+            if (symbolTable.GetAddress(id) < 0)
+                symbolTable.SetAddress(id, codes.size());
+
+            break;
+        }
+        case InstructionType::C_INSTRUCTION:
+            codes.push_back(EncodeC(parser));
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    int var_address = 16;
+    for (const auto &[index, id] : unresolved)
+    {
+        if (symbolTable.GetAddress(id) < 0)
+        {
+            symbolTable.SetAddress(id, var_address);
+            var_address++;
+        }
+
+        codes[index] = symbolTable.GetAddress(id);
+    }
+
+    return codes;
+}
+
+// Part of the source cut at a line boundary. Every symbolic reference is
+// left unresolved; labels are recorded relative to the start of the chunk.
+struct Chunk
+{
+    std::string_view source;
+    std::vector<uint16_t> codes;
+    SymbolTable symbolTable;
+    std::vector<std::pair<size_t, int>> unresolved;
+    std::vector<int> addresses; // chunk symbol id -> final address
+    size_t offset = 0;
+};
+
+inline void AssembleChunk(Chunk &chunk)
+{
+    Parser parser(chunk.source);
+    while (parser.HasMoreLines())
+    {
+        parser.Advance();
+        auto type = parser.GetInstructionType();
+        switch (type)
+        {
+        case InstructionType::A_INSTRUCTION:
+        {
+            auto symbol = parser.Symbol();
+            if (!isdigit(symbol[0]))
+            {
+                chunk.unresolved.emplace_back(chunk.codes.size(), chunk.symbolTable.Intern(symbol));
+                chunk.codes.push_back(0);
+            }
+            else
+                chunk.codes.push_back(ParseNumber(symbol));
+
+            break;
+        }
+        case InstructionType::L_INSTRUCTION:
+        {
+            auto id = chunk.symbolTable.Intern(parser.Symbol());
+            if (chunk.symbolTable.GetAddress(id) < 0)
+                chunk.symbolTable.SetAddress(id, chunk.codes.size());
+
+            break;
+        }
+        case InstructionType::C_INSTRUCTION:
+            chunk.codes.push_back(EncodeC(parser));
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+// Parses and encodes chunks of the source on separate threads. Label
+// addresses are the chunk offsets (a prefix sum over the chunk sizes) plus
+// the chunk-relative address. Symbols are then merged chunk by chunk in
+// source order, and within a chunk in first-use order, so variables get
+// the same addresses as in the single-threaded assembler.
+inline std::vector<uint16_t> AssembleParallel(std::string_view source, int jobs)
+{
+    std::vector<Chunk> chunks(jobs);
+    size_t begin = 0;
+    for (int i = 0; i < jobs; i++)
+    {
+        auto end = source.size() * (i + 1) / jobs;
+        if (end < source.size())
+        {
+            end = source.find('\n', std::max(begin, end));
+            end = end == std::string_view::npos ? source.size() : end + 1;
+        }
+
+        chunks[i].source = source.substr(begin, end - begin);
+        begin = end;
+    }
+
+    auto forEachChunk = [&chunks](auto work) {
+        std::vector<std::thread> threads;
+        for (auto &chunk : chunks)
+            threads.emplace_back(work, std::ref(chunk));
+        for (auto &thread : threads)
+            thread.join();
+    };
+
+    forEachChunk(AssembleChunk);
+
+    SymbolTable symbolTable;
+    AddPredefinedSymbols(symbolTable);
+
+    size_t size = 0;
+    for (auto &chunk : chunks)
+    {
+        chunk.offset = size;
+        size += chunk.codes.size();
+
+        for (int id = 0; id < chunk.symbolTable.Size(); id++)
+        {
+            auto address = chunk.symbolTable.GetAddress(id);
+            if (address < 0)
+                continue;
+
+            auto global = symbolTable.Intern(chunk.symbolTable.Name(id));
+            if (symbolTable.GetAddress(global) < 0)
+                symbolTable.SetAddress(global, chunk.offset + address);
+        }
+    }
+
+    int var_address = 16;
+    for (auto &chunk : chunks)
+    {
+        chunk.addresses.resize(chunk.symbolTable.Size());
+        for (int id = 0; id < chunk.symbolTable.Size(); id++)
+        {
+            auto global = symbolTable.Intern(chunk.symbolTable.Name(id));
+            if (symbolTable.GetAddress(global) < 0)
+            {
+                symbolTable.SetAddress(global, var_address);
+                var_address++;
+            }
+
+            chunk.addresses[id] = symbolTable.GetAddress(global);
+        }
+    }
+
+    std::vector<uint16_t> codes(size);
+    forEachChunk([&codes](Chunk &chunk) {
+        for (const auto &[index, id] : chunk.unresolved)
+            chunk.codes[index] = chunk.addresses[id];
+
+        std::copy(chunk.codes.begin(), chunk.codes.end(), codes.begin() + chunk.offset);
+    });
+
+    return codes;
+}
+
+// Assembles Hack assembly source into ROM words.
+inline std::vector<uint16_t> Assemble(std::string_view source)
+{
+    return AssembleOnePass(source);
+}
+
+// Assembles source fed in pieces and emits every word as soon as all
+// references before it are resolved, so only the output after the oldest
+// unresolved reference is held, as words rather than text. A symbol that
+// never becomes a label is a variable and can only be given its address at
+// the end of the input, since a label of that name may still follow.
+// Memory therefore stays flat only for programs without variables: from the
+// first reference to a variable on, every word is held until Finish(). That
+// includes translator output, whose static File.N symbols are variables.
+class StreamAssembler
+{
+public:
+    StreamAssembler(std::function<void(uint16_t)> emit)
+        : emit(std::move(emit))
+    {
+        AddPredefinedSymbols(symbolTable);
+    }
+
+    // source must consist of whole lines
+    void Feed(std::string_view source)
+    {
+        Parser parser(source);
+        while (parser.HasMoreLines())
+        {
+            parser.Advance();
+            auto type = parser.GetInstructionType();
+            switch (type)
+            {
+            case InstructionType::A_INSTRUCTION:
+            {
+                auto symbol = parser.Symbol();
+                if (!isdigit(symbol[0]))
+                {
+                    auto id = symbolTable.Intern(symbol);
+                    if (symbolTable.GetAddress(id) < 0)
+                    {
+                        if (static_cast<size_t>(id) >= waiting.size())
+                            waiting.resize(id + 1);
+
+                        waiting[id].push_back(count);
+                        unresolved.emplace_back(count, id);
+                        Push(0);
+                    }
+                    else
+                        Push(symbolTable.GetAddress(id));
+                }
+                else
+                    Push(ParseNumber(symbol));
+
+                break;
+            }
+            case InstructionType::L_INSTRUCTION:
+            {
+                auto id = symbolTable.Intern(parser.Symbol());
+                if (symbolTable.GetAddress(id) < 0)
+                {
+                    Resolve(id, count);
+                    Flush();
+                }
+
+                break;
+            }
+            case InstructionType::C_INSTRUCTION:
+                Push(EncodeC(parser));
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    void Finish()
+    {
+        int var_address = 16;
+        for (const auto &[index, id] : unresolved)
+        {
+            if (symbolTable.GetAddress(id) < 0)
+            {
+                Resolve(id, var_address);
+                var_address++;
+            }
+        }
+
+        unresolved.clear();
+        Flush();
+    }
+
+private:
+    void Push(uint16_t code)
+    {
+        count++;
+        if (unresolved.empty())
+            emit(code);
+        else
+            pending.push_back(code);
+    }
+
+    void Resolve(int id, int address)
+    {
+        symbolTable.SetAddress(id, address);
+        if (static_cast<size_t>(id) >= waiting.size())
+            return;
+
+        for (auto index : waiting[id])
+            pending[index - (count - pending.size())] = address;
+
+        waiting[id].clear();
+        waiting[id].shrink_to_fit();
+    }
+
+    void Flush()
+    {
+        while (!unresolved.empty() && symbolTable.GetAddress(unresolved.front().second) >= 0)
+            unresolved.pop_front();
+
+        auto end = unresolved.empty() ? count : unresolved.front().first;
+        for (auto index = count - pending.size(); index < end; index++)
+        {
+            emit(pending.front());
+            pending.pop_front();
+        }
+    }
+
+private:
+    std::function<void(uint16_t)> emit;
+    SymbolTable symbolTable;
+    size_t count = 0;
+    std::deque<uint16_t> pending;
+    std::deque<std::pair<size_t, int>> unresolved;
+    std::vector<std::vector<size_t>> waiting;
+};
+
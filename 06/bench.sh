@@ -0,0 +1,54 @@
+# g++ --std=c++17 -O2 -pthread assembler.cc -o assembler
+# usage: sh bench.sh [scale]
+scale=${1:-1000}
+tmp=$(mktemp -d)
+
+# whole assembler: two-pass vs one-pass on Pong.asm scaled up
+big=$tmp/PongX.asm
+for i in $(seq $scale); do cat pong/Pong.asm; done > $big
+ls -l $big
+
+echo "two-pass:"
+time ./assembler --two-pass $big
+echo "one-pass:"
+time ./assembler $big
+
+# parallel scaling, 1 to N threads
+jobs=1
+while [ $jobs -le $(nproc) ]; do
+    echo "jobs $jobs:"
+    time ./assembler --jobs $jobs $big
+    jobs=$((jobs * 2))
+done
+
+# encoder: every dest=comp;jump combination, repeated, through the whole
+# assembler including file mapping and output
+enc=$tmp/Encode.asm
+awk -v rounds=$scale 'BEGIN {
+    nc = split("0 1 -1 D A M !D !A !M -D -A -M D+1 A+1 M+1 D-1 A-1 M-1 D+A D+M D-A D-M A-D M-D D&A D&M D|A D|M", c, " ")
+    nd = split(",M,D,MD,A,AM,AD,AMD", d, ",")
+    nj = split(",JGT,JEQ,JGE,JLT,JNE,JLE,JMP", j, ",")
+    for (r = 0; r < rounds; r++)
+        for (x = 1; x <= nc; x++)
+            for (y = 1; y <= nd; y++)
+                for (z = 1; z <= nj; z++)
+                    print (d[y] == "" ? "" : d[y] "=") c[x] (j[z] == "" ? "" : ";" j[z])
+}' > $enc
+count=$(wc -l < $enc)
+start=$(date +%s.%N)
+./assembler $enc
+end=$(date +%s.%N)
+awk -v n=$count -v s=$start -v e=$end 'BEGIN { printf "encode, whole assembler: %d instructions, %.0f instructions/s\n", n, n / (e - s) }'
+# the comp/jump lookups alone, against a linear scan of the same mnemonics
+./assembler --bench-encode $((scale * 100))
+
+# symbol table: 100k labels, each referenced before and after its definition
+sym=$tmp/Labels.asm
+awk -v labels=100000 'BEGIN {
+    for (i = 0; i < labels; i++)
+        print "@LOOP_" i "\n0;JMP\n(LOOP_" i ")\n@LOOP_" i "\nD=A\n@var_" i % 1000 "\nM=D"
+}' > $sym
+echo "symbols: $(grep -c '^(' $sym) labels"
+time ./assembler $sym
+
+rm -r $tmp
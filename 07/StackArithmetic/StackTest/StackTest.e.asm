@@ -22,20 +22,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label0
+@StackTest$Label0
 D;JEQ
 @SP
 A=M
 M=0
-@Label1
+@StackTest$Label1
 0;JMP
-(Label0)
+(StackTest$Label0)
 @SP
 A=M
 M=-1
-@Label1
+@StackTest$Label1
 0;JMP
-(Label1)
+(StackTest$Label1)
 @SP
 M=M+1
 @17
@@ -62,20 +62,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label2
+@StackTest$Label2
 D;JEQ
 @SP
 A=M
 M=0
-@Label3
+@StackTest$Label3
 0;JMP
-(Label2)
+(StackTest$Label2)
 @SP
 A=M
 M=-1
-@Label3
+@StackTest$Label3
 0;JMP
-(Label3)
+(StackTest$Label3)
 @SP
 M=M+1
 @16
@@ -102,20 +102,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label4
+@StackTest$Label4
 D;JEQ
 @SP
 A=M
 M=0
-@Label5
+@StackTest$Label5
 0;JMP
-(Label4)
+(StackTest$Label4)
 @SP
 A=M
 M=-1
-@Label5
+@StackTest$Label5
 0;JMP
-(Label5)
+(StackTest$Label5)
 @SP
 M=M+1
 @892
@@ -142,20 +142,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label6
+@StackTest$Label6
 D;JLT
 @SP
 A=M
 M=0
-@Label7
+@StackTest$Label7
 0;JMP
-(Label6)
+(StackTest$Label6)
 @SP
 A=M
 M=-1
-@Label7
+@StackTest$Label7
 0;JMP
-(Label7)
+(StackTest$Label7)
 @SP
 M=M+1
 @891
@@ -182,20 +182,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label8
+@StackTest$Label8
 D;JLT
 @SP
 A=M
 M=0
-@Label9
+@StackTest$Label9
 0;JMP
-(Label8)
+(StackTest$Label8)
 @SP
 A=M
 M=-1
-@Label9
+@StackTest$Label9
 0;JMP
-(Label9)
+(StackTest$Label9)
 @SP
 M=M+1
 @891
@@ -222,20 +222,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label10
+@StackTest$Label10
 D;JLT
 @SP
 A=M
 M=0
-@Label11
+@StackTest$Label11
 0;JMP
-(Label10)
+(StackTest$Label10)
 @SP
 A=M
 M=-1
-@Label11
+@StackTest$Label11
 0;JMP
-(Label11)
+(StackTest$Label11)
 @SP
 M=M+1
 @32767
@@ -262,20 +262,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label12
+@StackTest$Label12
 D;JGT
 @SP
 A=M
 M=0
-@Label13
+@StackTest$Label13
 0;JMP
-(Label12)
+(StackTest$Label12)
 @SP
 A=M
 M=-1
-@Label13
+@StackTest$Label13
 0;JMP
-(Label13)
+(StackTest$Label13)
 @SP
 M=M+1
 @32766
@@ -302,20 +302,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label14
+@StackTest$Label14
 D;JGT
 @SP
 A=M
 M=0
-@Label15
+@StackTest$Label15
 0;JMP
-(Label14)
+(StackTest$Label14)
 @SP
 A=M
 M=-1
-@Label15
+@StackTest$Label15
 0;JMP
-(Label15)
+(StackTest$Label15)
 @SP
 M=M+1
 @32766
@@ -342,20 +342,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label16
+@StackTest$Label16
 D;JGT
 @SP
 A=M
 M=0
-@Label17
+@StackTest$Label17
 0;JMP
-(Label16)
+(StackTest$Label16)
 @SP
 A=M
 M=-1
-@Label17
+@StackTest$Label17
 0;JMP
-(Label17)
+(StackTest$Label17)
 @SP
 M=M+1
 @57
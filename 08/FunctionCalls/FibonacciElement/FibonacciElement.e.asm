@@ -52,67 +52,6 @@ M=D
 @Sys.init
 0;JMP
 ($ret.0)
-(Sys.init)
-@4
-D=A
-@SP
-A=M
-M=D
-@SP
-M=M+1
-@Sys.init$ret.0
-D=A
-@SP
-A=M
-M=D
-@SP
-M=M+1
-@LCL
-D=M
-@SP
-A=M
-M=D
-@SP
-M=M+1
-@ARG
-D=M
-@SP
-A=M
-M=D
-@SP
-M=M+1
-@THIS
-D=M
-@SP
-A=M
-M=D
-@SP
-M=M+1
-@THAT
-D=M
-@SP
-A=M
-M=D
-@SP
-M=M+1
-@SP
-D=M
-@5
-D=D-A
-@1
-D=D-A
-@ARG
-M=D
-@SP
-D=M
-@LCL
-M=D
-@Main.fibonacci
-0;JMP
-(Sys.init$ret.0)
-(Sys.init$WHILE)
-@Sys.init$WHILE
-0;JMP
 (Main.fibonacci)
 @0
 D=A
@@ -141,20 +80,20 @@ M=M-1
 @SP
 A=M
 D=M-D
-@Label0
+@Main$Label0
 D;JLT
 @SP
 A=M
 M=0
-@Label1
+@Main$Label1
 0;JMP
-(Label0)
+(Main$Label0)
 @SP
 A=M
 M=-1
-@Label1
+@Main$Label1
 0;JMP
-(Label1)
+(Main$Label1)
 @SP
 M=M+1
 @SP
@@ -456,3 +395,64 @@ M=D
 @R14
 A=M
 0;JMP
+(Sys.init)
+@4
+D=A
+@SP
+A=M
+M=D
+@SP
+M=M+1
+@Sys.init$ret.0
+D=A
+@SP
+A=M
+M=D
+@SP
+M=M+1
+@LCL
+D=M
+@SP
+A=M
+M=D
+@SP
+M=M+1
+@ARG
+D=M
+@SP
+A=M
+M=D
+@SP
+M=M+1
+@THIS
+D=M
+@SP
+A=M
+M=D
+@SP
+M=M+1
+@THAT
+D=M
+@SP
+A=M
+M=D
+@SP
+M=M+1
+@SP
+D=M
+@5
+D=D-A
+@1
+D=D-A
+@ARG
+M=D
+@SP
+D=M
+@LCL
+M=D
+@Main.fibonacci
+0;JMP
+(Sys.init$ret.0)
+(Sys.init$WHILE)
+@Sys.init$WHILE
+0;JMP
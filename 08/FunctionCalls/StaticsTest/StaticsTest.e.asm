@@ -52,7 +52,7 @@ M=D
 @Sys.init
 0;JMP
 ($ret.0)
-(Class2.set)
+(Class1.set)
 @0
 D=A
 @ARG
@@ -68,7 +68,7 @@ M=M-1
 @SP
 A=M
 D=M
-@Class2.0
+@Class1.0
 M=D
 @1
 D=A
@@ -85,7 +85,7 @@ M=M-1
 @SP
 A=M
 D=M
-@Class2.1
+@Class1.1
 M=D
 @0
 D=A
@@ -148,15 +148,15 @@ M=D
 @R14
 A=M
 0;JMP
-(Class2.get)
-@Class2.0
+(Class1.get)
+@Class1.0
 D=M
 @SP
 A=M
 M=D
 @SP
 M=M+1
-@Class2.1
+@Class1.1
 D=M
 @SP
 A=M
@@ -229,7 +229,7 @@ M=D
 @R14
 A=M
 0;JMP
-(Class1.set)
+(Class2.set)
 @0
 D=A
 @ARG
@@ -245,7 +245,7 @@ M=M-1
 @SP
 A=M
 D=M
-@Class1.0
+@Class2.0
 M=D
 @1
 D=A
@@ -262,7 +262,7 @@ M=M-1
 @SP
 A=M
 D=M
-@Class1.1
+@Class2.1
 M=D
 @0
 D=A
@@ -325,15 +325,15 @@ M=D
 @R14
 A=M
 0;JMP
-(Class1.get)
-@Class1.0
+(Class2.get)
+@Class2.0
 D=M
 @SP
 A=M
 M=D
 @SP
 M=M+1
-@Class1.1
+@Class2.1
 D=M
 @SP
 A=M
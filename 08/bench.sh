@@ -0,0 +1,87 @@
+# g++ --std=c++17 -O2 -pthread translator.cc -o translator
+# needs ../11/compiler, ../06/assembler and ../05/emulator built as well
+# usage: sh bench.sh [app dir] [stop function]
+# A Jack app is compiled together with the OS from ../12, a directory of
+# .vm files is taken as is. Reports ROM size under each translator mode and
+# the cycles it takes to reach [stop function] or the final halt loop, then
+# the translation throughput in VM commands per second. A run that reaches
+# neither within the cycle cap is reported as a failure.
+# The default app is FunctionCalls/FibonacciElement computing element FIB_N
+# (20 by default) instead of 4, which terminates in the halt loop.
+app=${1:-FunctionCalls/FibonacciElement}
+stop=$2
+cap=1000000000
+failed=0
+
+tmp=$(mktemp -d)
+dir=$tmp/Prog
+mkdir $dir
+if ls $app/*.jack > /dev/null 2>&1; then
+    cp ../12/*.jack $app/*.jack $dir
+    ../11/compiler $dir/ > /dev/null
+    for f in $dir/*.vm.g; do mv $f ${f%.g}; done
+else
+    cp $app/*.vm $dir
+fi
+if [ -z "$1" ]; then
+    sed -i "s/^push constant 4\r*$/push constant ${FIB_N:-20}/" $dir/Sys.vm
+fi
+echo "VM commands: $(cat $dir/*.vm | grep -v '^ *//' | grep -c .)"
+
+for flags in "" "--peephole" "--cache-top" "--cache-top --peephole" \
+    "--shared-compare --cache-top --peephole" "--shared-call --peephole" \
+    "--shared-call --shared-compare --cache-top --peephole" \
+    "--eliminate-dead --shared-call --shared-compare --cache-top --peephole"; do
+    echo "translator $flags:"
+    ./translator $flags $dir/ > /dev/null
+    ../06/assembler $dir/Prog.asm
+    rom=$(wc -l < $dir/Prog.hack)
+    echo "    ROM: $rom"
+    if [ $rom -gt 32768 ]; then
+        echo "    does not fit in ROM32K"
+        continue
+    fi
+
+    address=-1
+    if [ -n "$stop" ]; then
+        address=$(awk -v label="($stop)" '$0 == label { print n; exit } /^[^(]/ { n++ }' $dir/Prog.asm)
+        if [ -z "$address" ]; then
+            echo "    stop function $stop not found"
+            failed=1
+            continue
+        fi
+    fi
+    result=$(../05/emulator --stop $address --cycles $cap $dir/Prog.hack)
+    if [ "${result%% *}" -ge $cap ]; then
+        echo "    stop not reached within $cap instructions"
+        failed=1
+    else
+        echo "    $result"
+    fi
+done
+
+# translation throughput on one synthetic .vm file of LINES_VM commands (1M by default)
+lines=${LINES_VM:-1000000}
+mkdir -p $tmp/Synthetic
+awk -v n=$lines 'BEGIN {
+    split("add sub neg eq gt lt and or not", ops, " ")
+    split("local argument this that temp static", segs, " ")
+    for (i = 0; i < n; i++) {
+        r = i % 16
+        if (r == 0) print "function F" int(i / 1000) ".f" (i % 1000) " 2"
+        else if (r < 6) print "push " segs[1 + i % 6] " " (i % 5)
+        else if (r < 8) print "push constant " i % 32768
+        else if (r < 11) print ops[1 + i % 9]
+        else if (r < 13) print "pop " segs[1 + i % 6] " " (i % 5)
+        else if (r == 13) print "label L" i
+        else if (r == 14) print "if-goto L" (i - 1)
+        else print "call F0.f0 1"
+    }
+}' > $tmp/Synthetic/Synthetic.vm
+start=$(date +%s.%N)
+./translator $tmp/Synthetic/Synthetic.vm > /dev/null
+end=$(date +%s.%N)
+echo "translate $lines VM commands: $(echo "$start $end $lines" | awk '{ printf "%.3f s, %.0f commands/s", $2 - $1, $3 / ($2 - $1) }')"
+
+rm -r $tmp
+exit $failed
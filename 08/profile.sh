@@ -0,0 +1,15 @@
+# usage: sh profile.sh Prog.profile ram.txt
+# Prints the entry count of every function of a program translated with
+# --profile, most called first, from a RAM dump of ../05/emulator --dump.
+awk 'NR == FNR { name[$1] = $2; next }
+    { word = $1 < 0 ? $1 + 65536 : $1; ram[FNR - 1] = word }
+    END {
+        for (address in name) {
+            count = ram[address] + ram[address + 1] * 65536
+            total += count
+            counts[address] = count
+        }
+        for (address in name)
+            if (counts[address] > 0)
+                printf "%12d %6.2f%%  %s\n", counts[address], 100 * counts[address] / total, name[address]
+    }' $1 $2 | sort -rn
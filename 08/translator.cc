@@ -1,9 +1,17 @@
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 #include <bitset>
 #include <map>
+#include <charconv>
+#include <string_view>
+#include <set>
 #include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
 #include <boost/algorithm/string.hpp>
 
 enum class CommandType
@@ -19,7 +27,75 @@ enum class CommandType
     C_CALL,
 };
 
-static const std::vector<std::string> operators = {"add", "sub", "neg", "eq", "gt", "lt", "and", "or", "not"};
+enum class Operator
+{
+    ADD,
+    SUB,
+    NEG,
+    EQ,
+    GT,
+    LT,
+    AND,
+    OR,
+    NOT,
+};
+
+enum class Segment
+{
+    NONE,
+    CONSTANT,
+    LOCAL,
+    ARGUMENT,
+    THIS,
+    THAT,
+    TEMP,
+    POINTER,
+    STATIC,
+};
+
+static const std::map<std::string, Operator, std::less<>> operators = {
+    {"add", Operator::ADD},
+    {"sub", Operator::SUB},
+    {"neg", Operator::NEG},
+    {"eq", Operator::EQ},
+    {"gt", Operator::GT},
+    {"lt", Operator::LT},
+    {"and", Operator::AND},
+    {"or", Operator::OR},
+    {"not", Operator::NOT},
+};
+
+static const std::map<std::string, CommandType, std::less<>> commandTypes = {
+    {"push", CommandType::C_PUSH},
+    {"pop", CommandType::C_POP},
+    {"label", CommandType::C_LABEL},
+    {"if-goto", CommandType::C_IF},
+    {"goto", CommandType::C_GOTO},
+    {"function", CommandType::C_FUNCTION},
+    {"return", CommandType::C_RETURN},
+    {"call", CommandType::C_CALL},
+};
+
+static const std::map<std::string, Segment, std::less<>> segments = {
+    {"constant", Segment::CONSTANT},
+    {"local", Segment::LOCAL},
+    {"argument", Segment::ARGUMENT},
+    {"this", Segment::THIS},
+    {"that", Segment::THAT},
+    {"temp", Segment::TEMP},
+    {"pointer", Segment::POINTER},
+    {"static", Segment::STATIC},
+};
+
+// One VM command, classified once when it is read.
+struct Command
+{
+    CommandType type = CommandType::C_RETURN;
+    Operator op = Operator::ADD;     // C_ARITHMETIC
+    Segment segment = Segment::NONE; // C_PUSH, C_POP
+    int arg2 = 0;                    // index, or nVars of function and call
+    std::string arg1;                // label or function name
+};
 
 class Parser
 {
@@ -39,42 +115,65 @@ public:
 
     void Advance()
     {
-        while (std::getline(inputstream, command))
+        while (std::getline(inputstream, line))
         {
-            boost::trim(command);
-            if (command.empty() || command.substr(0, 2) == "//")
+            boost::trim(line);
+            if (line.empty() || line.substr(0, 2) == "//")
                 continue;
 
-            auto pos = command.find_first_of("//");
+            auto pos = line.find_first_of("//");
             if (pos != std::string::npos)
             {
-                command = command.substr(0, pos);
-                boost::trim(command);
+                line = line.substr(0, pos);
+                boost::trim(line);
             }
 
             break;
         }
 
-        std::vector<std::string> words;
-        boost::split(words, command, boost::is_any_of(" "));
-        command = words[0];
+        std::string_view words[3];
+        std::string_view rest(line);
+        for (auto &word : words)
+        {
+            auto end = rest.find(' ');
+            word = rest.substr(0, end);
+            rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+        }
 
-        switch (GetCommandType())
+        command = Command();
+        if (auto op = operators.find(words[0]); op != operators.end())
+        {
+            command.type = CommandType::C_ARITHMETIC;
+            command.op = op->second;
+            return;
+        }
+
+        auto type = commandTypes.find(words[0]);
+        if (type == commandTypes.end())
+            throw "should not reach here...";
+        command.type = type->second;
+
+        switch (command.type)
         {
-        case CommandType::C_ARITHMETIC:
-            arg1 = words[0];
-            break;
         case CommandType::C_PUSH:
         case CommandType::C_POP:
+        {
+            auto segment = segments.find(words[1]);
+            if (segment == segments.end())
+                throw "should not reach here...";
+            command.segment = segment->second;
+            command.arg2 = ToInt(words[2]);
+            break;
+        }
         case CommandType::C_FUNCTION:
         case CommandType::C_CALL:
-            arg1 = words[1];
-            arg2 = words[2];
+            command.arg1 = words[1];
+            command.arg2 = ToInt(words[2]);
             break;
         case CommandType::C_LABEL:
         case CommandType::C_IF:
         case CommandType::C_GOTO:
-            arg1 = words[1];
+            command.arg1 = words[1];
             break;
         case CommandType::C_RETURN:
             // do nothing
@@ -86,56 +185,254 @@ public:
 
     CommandType GetCommandType() const
     {
-        if (std::find(operators.begin(), operators.end(), command) != operators.end())
-            return CommandType::C_ARITHMETIC;
-        else if (command == "push")
-            return CommandType::C_PUSH;
-        else if (command == "pop")
-            return CommandType::C_POP;
-        else if (command == "label")
-            return CommandType::C_LABEL;
-        else if (command == "if-goto")
-            return CommandType::C_IF;
-        else if (command == "goto")
-            return CommandType::C_GOTO;
-        else if (command == "function")
-            return CommandType::C_FUNCTION;
-        else if (command == "return")
-            return CommandType::C_RETURN;
-        else if (command == "call")
-            return CommandType::C_CALL;
-        else
-            throw "should not reach here...";
+        return command.type;
+    }
+
+    Operator GetOperator() const
+    {
+        return command.op;
+    }
+
+    Segment GetSegment() const
+    {
+        return command.segment;
+    }
+
+    const std::string &Arg1() const
+    {
+        return command.arg1;
     }
 
-    std::string Arg1() const
+    int Arg2() const
     {
-        return arg1;
+        return command.arg2;
     }
 
-    std::string Arg2() const
+private:
+    static int ToInt(std::string_view word)
     {
-        return arg2;
+        int value = 0;
+        auto result = std::from_chars(word.data(), word.data() + word.size(), value);
+        if (result.ec != std::errc() || result.ptr != word.data() + word.size())
+            throw "should not reach here...";
+
+        return value;
     }
 
 private:
     std::ifstream inputstream;
-    std::string command;
-    std::string arg1;
-    std::string arg2;
+    std::string line;
+    Command command;
+};
+
+// Rewrites short instruction sequences that CodeWriter produces when it
+// expands every VM command on its own. Each rule leaves RAM, D and the
+// following control flow unchanged:
+//   @SP M=M+1 @SP M=M-1      -> (nothing), when the next line sets A
+//   @SP A=M M=D @SP A=M      -> @SP A=M M=D
+//   M=D D=M                  -> M=D
+//   @SP M=M-1 @SP A=M        -> @SP AM=M-1
+//   @SP A=M M=D @SP M=M+1    -> @SP M=M+1 A=M-1 M=D, when the next line sets A
+class PeepholeOptimizer
+{
+public:
+    PeepholeOptimizer() = delete;
+
+    static std::vector<std::string> Run(const std::vector<std::string> &lines)
+    {
+        std::vector<std::string> out;
+        for (const auto &line : lines)
+        {
+            out.push_back(line);
+            while (Reduce(out))
+                ;
+        }
+
+        std::vector<std::string> result;
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            if (i + 5 < out.size() &&
+                Match(out, i, {"@SP", "A=M", "M=D", "@SP", "M=M+1"}) && SetsA(out[i + 5]))
+            {
+                result.insert(result.end(), {"@SP", "M=M+1", "A=M-1", "M=D"});
+                i += 4;
+            }
+            else
+                result.push_back(out[i]);
+        }
+
+        return result;
+    }
+
+    static size_t CountInstructions(const std::vector<std::string> &lines)
+    {
+        return std::count_if(lines.begin(), lines.end(),
+                             [](const std::string &line) { return line[0] != '('; });
+    }
+
+private:
+    static bool SetsA(const std::string &line)
+    {
+        return line[0] == '@' || line[0] == '(';
+    }
+
+    static bool Match(const std::vector<std::string> &lines, size_t from, std::initializer_list<const char *> pattern)
+    {
+        for (auto p : pattern)
+        {
+            if (from >= lines.size() || lines[from++] != p)
+                return false;
+        }
+
+        return true;
+    }
+
+    static bool EndsWith(const std::vector<std::string> &lines, std::initializer_list<const char *> pattern)
+    {
+        return lines.size() >= pattern.size() && Match(lines, lines.size() - pattern.size(), pattern);
+    }
+
+    static bool Reduce(std::vector<std::string> &out)
+    {
+        if (out.size() >= 5 && SetsA(out.back()) &&
+            Match(out, out.size() - 5, {"@SP", "M=M+1", "@SP", "M=M-1"}))
+        {
+            auto next = out.back();
+            out.resize(out.size() - 5);
+            out.push_back(next);
+            return true;
+        }
+
+        if (EndsWith(out, {"@SP", "A=M", "M=D", "@SP", "A=M"}))
+        {
+            out.resize(out.size() - 2);
+            return true;
+        }
+
+        if (EndsWith(out, {"M=D", "D=M"}))
+        {
+            out.pop_back();
+            return true;
+        }
+
+        if (EndsWith(out, {"@SP", "M=M-1", "@SP", "A=M"}))
+        {
+            out.resize(out.size() - 4);
+            out.insert(out.end(), {"@SP", "AM=M-1"});
+            return true;
+        }
+
+        return false;
+    }
+};
+
+struct TranslatorOptions
+{
+    bool peephole = false;
+    bool cacheTop = false; // keep the top of the VM stack in D
+    bool sharedCompare = false; // eq/gt/lt call one routine per type
+    bool sharedCall = false; // call/return jump to one frame routine each
+    bool eliminateDead = false; // drop functions Sys.init never reaches
+    bool profile = false; // count function entries in RAM
+    std::map<std::string, int> counters; // function -> counter address
+};
+
+// Profile counters are 32 bits, low word first, and sit at the top of the
+// heap right below the screen, the part an allocator reaches last. Writes
+// at KBD and above do not stick on the Hack computer.
+static constexpr int PROFILE_END = 16384;
+
+// Append-only text buffer for CodeWriter. An append is a plain copy into
+// one std::string, without the locale and sentry work of an ostream insert,
+// and the whole program is written to the file with a single write.
+class OutputBuffer
+{
+public:
+    OutputBuffer &operator<<(std::string_view text)
+    {
+        buffer.append(text);
+        return *this;
+    }
+
+    OutputBuffer &operator<<(int value)
+    {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+
+    const std::string &str() const
+    {
+        return buffer;
+    }
+
+    void Flush(std::ostream &output)
+    {
+        output.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+private:
+    std::string buffer;
 };
 
 class CodeWriter
 {
 public:
-    CodeWriter(const std::filesystem::path &filename)
-        : outputstream(filename),
+    CodeWriter(const std::filesystem::path &filename, const TranslatorOptions &options = {})
+        : outputfile(filename),
+          options(options),
           label(0),
           fileName(""),
           functionName(""),
           functionLabel(0) {}
 
-    ~CodeWriter() { outputstream.close(); }
+    // Translates one file into memory only, to be appended to the writer
+    // of the whole program afterwards.
+    CodeWriter(const TranslatorOptions &options)
+        : options(options),
+          label(0),
+          fileName(""),
+          functionName(""),
+          functionLabel(0) {}
+
+    ~CodeWriter()
+    {
+        if (!outputfile.is_open())
+            return;
+
+        Spill();
+        WriteSharedRoutines();
+
+        if (!options.peephole)
+        {
+            ReportSize(CountInstructions());
+            outputstream.Flush(outputfile);
+            return;
+        }
+
+        std::vector<std::string> lines;
+        const auto &text = outputstream.str();
+        for (size_t begin = 0; begin < text.size();)
+        {
+            auto end = text.find('\n', begin);
+            lines.emplace_back(text, begin, end - begin);
+            begin = end + 1;
+        }
+
+        auto optimized = PeepholeOptimizer::Run(lines);
+        OutputBuffer buffer;
+        for (const auto &line : optimized)
+            buffer << line << "\n";
+        buffer.Flush(outputfile);
+
+        auto before = PeepholeOptimizer::CountInstructions(lines);
+        auto after = PeepholeOptimizer::CountInstructions(optimized);
+        std::cout << "peephole: " << before << " -> " << after << " instructions, "
+                  << before - after << " saved\n";
+        ReportSize(after);
+    }
 
     void Init()
     {
@@ -148,12 +445,39 @@ public:
 
     void SetFileName(const std::string &fileName)
     {
+        Spill();
         this->fileName = fileName;
     }
 
-    void WriteOperator(const std::string &op)
+    // Appends the code of a file translated on its own, together with the
+    // shared routines it needs.
+    void Append(CodeWriter &part)
+    {
+        Spill();
+        part.Spill();
+
+        outputstream << part.outputstream.str();
+        for (const auto &[op, count] : part.compares)
+            compares[op] += count;
+        calls += part.calls;
+        returns += part.returns;
+    }
+
+    void WriteOperator(Operator op)
     {
-        if (op != "neg" && op != "not")
+        if (options.sharedCompare && IsCompare(op))
+        {
+            WriteSharedCompare(op);
+            return;
+        }
+
+        if (options.cacheTop)
+        {
+            WriteCachedOperator(op);
+            return;
+        }
+
+        if (op != Operator::NEG && op != Operator::NOT)
         {
             SPDesc();
 
@@ -168,26 +492,20 @@ public:
             outputstream << "@SP\n";
             outputstream << "A=M\n";
 
-            if (op == "add")
+            if (op == Operator::ADD)
                 outputstream << "M=D+M\n";
-            else if (op == "sub")
+            else if (op == Operator::SUB)
                 outputstream << "M=M-D\n";
-            else if (op == "eq" || op == "gt" || op == "lt")
+            else if (IsCompare(op))
             {
                 outputstream << "D=M-D\n";
                 auto to = NewLabel();
                 auto back = NewLabel();
 
-                std::string jump;
-                if (op == "eq")
-                    jump = "JEQ";
-                else if (op == "gt")
-                    jump = "JGT";
-                else
-                    jump = "JLT";
+                auto jump = JumpOf(op);
 
                 AtLabel(to);
-                outputstream << "D;" + jump + "\n";
+                outputstream << "D;" << jump << "\n";
                 SetSP(0);
                 Goto(back);
 
@@ -197,9 +515,9 @@ public:
 
                 WriteLabel(back);
             }
-            else if (op == "and")
+            else if (op == Operator::AND)
                 outputstream << "M=D&M\n";
-            else if (op == "or")
+            else if (op == Operator::OR)
                 outputstream << "M=D|M\n";
 
             SPInc();
@@ -212,7 +530,7 @@ public:
             outputstream << "@SP\n";
             outputstream << "A=M\n";
 
-            if (op == "neg")
+            if (op == Operator::NEG)
                 outputstream << "M=-M\n";
             else
                 outputstream << "M=!M\n";
@@ -221,14 +539,20 @@ public:
         }
     }
 
-    void WritePushPop(CommandType type, const std::string &segment, int index)
+    void WritePushPop(CommandType type, Segment segment, int index)
     {
-        if (segment == "constant")
+        if (options.cacheTop)
+        {
+            WriteCachedPushPop(type, segment, index);
+            return;
+        }
+
+        if (segment == Segment::CONSTANT)
         {
             assert(type == CommandType::C_PUSH);
 
             // D=index
-            outputstream << "@" << std::to_string(index) << "\n";
+            outputstream << "@" << index << "\n";
             outputstream << "D=A\n";
 
             // RAM[SP]=D
@@ -236,26 +560,26 @@ public:
         }
         // local, argument, this, that, and temp
         // LCL, ARG, THIS, and THAT
-        else if (segment == "local" || segment == "argument" || segment == "this" || segment == "that")
+        else if (segment == Segment::LOCAL || segment == Segment::ARGUMENT || segment == Segment::THIS || segment == Segment::THAT)
         {
             std::string base;
-            if (segment == "local")
+            if (segment == Segment::LOCAL)
                 base = "LCL";
-            else if (segment == "argument")
+            else if (segment == Segment::ARGUMENT)
                 base = "ARG";
-            else if (segment == "this")
+            else if (segment == Segment::THIS)
                 base = "THIS";
-            else if (segment == "that")
+            else if (segment == Segment::THAT)
                 base = "THAT";
 
             if (type == CommandType::C_PUSH)
             {
                 // D=index
-                outputstream << "@" << std::to_string(index) << "\n";
+                outputstream << "@" << index << "\n";
                 outputstream << "D=A\n";
 
                 // D = value at base+index
-                outputstream << "@" + base + "\n";
+                outputstream << "@" << base << "\n";
                 outputstream << "A=D+M\n";
                 outputstream << "D=M\n";
 
@@ -264,11 +588,11 @@ public:
             else // pop
             {
                 // D=index
-                outputstream << "@" << std::to_string(index) << "\n";
+                outputstream << "@" << index << "\n";
                 outputstream << "D=A\n";
 
                 // D = address(base+index)
-                outputstream << "@" + base + "\n";
+                outputstream << "@" << base << "\n";
                 outputstream << "D=D+M\n";
 
                 // R13=D=address(base+index)
@@ -285,14 +609,14 @@ public:
                 outputstream << "M=D\n";
             }
         }
-        else if (segment == "temp" || segment == "pointer" || segment == "static")
+        else if (segment == Segment::TEMP || segment == Segment::POINTER || segment == Segment::STATIC)
         {
             int offset = 5;
-            if (segment == "pointer")
+            if (segment == Segment::POINTER)
                 offset = 3;
 
             auto R = "R" + std::to_string(index + offset);
-            if (segment == "static")
+            if (segment == Segment::STATIC)
                 R = fileName + "." + std::to_string(index);
 
             if (type == CommandType::C_PUSH)
@@ -317,36 +641,108 @@ public:
 
     void WriteLabel(const std::string &label)
     {
+        Spill();
         InternalWriteLabel(GetFunctionLabel(label));
     }
 
     void WriteIf(const std::string &label)
     {
-        PopSPToD();
+        if (cached)
+            cached = false;
+        else
+            PopSPToD();
+
         AtLabel(GetFunctionLabel(label));
         outputstream << "D;JNE\n";
     }
 
     void WriterGoto(const std::string &label)
     {
+        Spill();
         Goto(GetFunctionLabel(label));
     }
 
     void WriteFunction(const std::string &functionName, int nVars)
     {
+        Spill();
+
         // init function
         this->functionName = functionName;
         this->functionLabel = 0;
 
         InternalWriteLabel(functionName);
 
+        if (options.profile)
+            WriteProfileCounter(functionName);
+
         for (int i = 0; i < nVars; i++)
         {
-            WritePushPop(CommandType::C_PUSH, "constant", 0);
+            WritePushPop(CommandType::C_PUSH, Segment::CONSTANT, 0);
         }
     }
 
     void WriteReturn()
+    {
+        Spill();
+
+        if (options.sharedCall)
+        {
+            Goto("__return");
+            returns++;
+            return;
+        }
+
+        WriteReturnFrame();
+    }
+
+    void WriteCall(const std::string &functionName, int nVars)
+    {
+        Spill();
+
+        auto retLabel = GenFunctionReturnLabel();
+        if (!options.sharedCall)
+        {
+            WriteCallFrame(retLabel, std::to_string(nVars), "A", functionName, "A");
+            InternalWriteLabel(retLabel);
+            return;
+        }
+
+        // R13 = nVars, R14 = f, D = return address
+        outputstream << "@" << nVars << "\n";
+        outputstream << "D=A\n";
+        outputstream << "@R13\n";
+        outputstream << "M=D\n";
+        outputstream << "@" << functionName << "\n";
+        outputstream << "D=A\n";
+        outputstream << "@R14\n";
+        outputstream << "M=D\n";
+        AtLabel(retLabel);
+        outputstream << "D=A\n";
+        Goto("__call");
+        InternalWriteLabel(retLabel);
+        calls++;
+    }
+
+private:
+    // counter++, carrying into the high word
+    void WriteProfileCounter(const std::string &functionName)
+    {
+        auto it = options.counters.find(functionName);
+        if (it == options.counters.end())
+            return;
+
+        auto done = NewLabel();
+        outputstream << "@" << it->second << "\n";
+        outputstream << "M=M+1\n";
+        outputstream << "D=M\n";
+        AtLabel(done);
+        outputstream << "D;JNE\n";
+        outputstream << "@" << it->second + 1 << "\n";
+        outputstream << "M=M+1\n";
+        WriteLabel(done);
+    }
+
+    void WriteReturnFrame()
     {
         // frame = LCL
         outputstream << "@LCL\n";
@@ -387,12 +783,19 @@ public:
         outputstream << "0;JMP\n";
     }
 
-    void WriteCall(const std::string &functionName, int nVars)
+    // The caller frame of call f nVars. Inline, retAddr is retLabel and
+    // nVars and f are constants read with A; in the shared routine the
+    // return address comes in D and nVars and f are read from R13 and R14
+    // with M.
+    void WriteCallFrame(const std::string &retLabel, const std::string &nVars, const std::string &nVarsReg,
+                        const std::string &functionName, const std::string &functionReg)
     {
         // push return address
-        auto retLabel = GenFunctionReturnLabel();
-        AtLabel(retLabel);
-        outputstream << "D=A\n";
+        if (!retLabel.empty())
+        {
+            AtLabel(retLabel);
+            outputstream << "D=A\n";
+        }
         PushDToSP();
 
         // push LCL
@@ -412,8 +815,8 @@ public:
         outputstream << "D=M\n"; // D = SP
         outputstream << "@5\n";
         outputstream << "D=D-A\n";
-        outputstream << "@" + std::to_string(nVars) + "\n";
-        outputstream << "D=D-A\n";
+        outputstream << "@" << nVars << "\n";
+        outputstream << "D=D-" << nVarsReg << "\n";
         outputstream << "@ARG\n";
         outputstream << "M=D\n";
 
@@ -424,28 +827,345 @@ public:
         outputstream << "M=D\n";
 
         // goto f
-        outputstream << "@" + functionName + "\n";
+        outputstream << "@" << functionName << "\n";
+        if (functionReg == "M")
+            outputstream << "A=M\n";
         outputstream << "0;JMP\n";
+    }
 
-        InternalWriteLabel(retLabel);
+    // With options.sharedCompare each comparison is a call to one routine
+    // per type, emitted once after the program, which returns through R15.
+    // On the RAM stack the routine pops both operands and pushes the result;
+    // with a cached top the call site leaves x-y in RAM[SP] and the routine
+    // returns the result in D.
+    void WriteSharedCompare(Operator op)
+    {
+        if (options.cacheTop)
+        {
+            Fill();
+            outputstream << "@SP\n";
+            outputstream << "AM=M-1\n";
+            outputstream << "D=M-D\n";
+            outputstream << "M=D\n";
+        }
+
+        auto back = NewLabel();
+        AtLabel(back);
+        outputstream << "D=A\n";
+        Goto(CompareRoutine(op));
+        WriteLabel(back);
+
+        compares[op]++;
+    }
+
+    void WriteSharedRoutines()
+    {
+        if (compares.empty() && calls == 0 && returns == 0)
+            return;
+
+        // the program must not run into the routines
+        InternalWriteLabel("__shared_end");
+        Goto("__shared_end");
+
+        if (calls > 0)
+        {
+            auto start = CountInstructions();
+            InternalWriteLabel("__call");
+            WriteCallFrame("", "R13", "M", "R14", "M");
+            callSize = CountInstructions() - start;
+        }
+
+        if (returns > 0)
+        {
+            auto start = CountInstructions();
+            InternalWriteLabel("__return");
+            WriteReturnFrame();
+            returnSize = CountInstructions() - start;
+        }
+
+        auto start = CountInstructions();
+
+        for (const auto &[op, count] : compares)
+        {
+            auto jump = JumpOf(op);
+            auto routine = CompareRoutine(op);
+
+            InternalWriteLabel(routine);
+            outputstream << "@R15\n";
+            outputstream << "M=D\n";
+
+            if (options.cacheTop)
+            {
+                // D=x-y from RAM[SP], result in D
+                SetSPToD();
+                AtLabel(routine + "_true");
+                outputstream << "D;" << jump << "\n";
+                outputstream << "D=0\n";
+                Goto(routine + "_return");
+                InternalWriteLabel(routine + "_true");
+                outputstream << "D=-1\n";
+            }
+            else
+            {
+                // pop y, D=x-y, x=true unless the jump says otherwise
+                outputstream << "@SP\n";
+                outputstream << "AM=M-1\n";
+                outputstream << "D=M\n";
+                outputstream << "A=A-1\n";
+                outputstream << "D=M-D\n";
+                outputstream << "M=-1\n";
+                AtLabel(routine + "_return");
+                outputstream << "D;" << jump << "\n";
+                outputstream << "@SP\n";
+                outputstream << "A=M-1\n";
+                outputstream << "M=0\n";
+            }
+
+            InternalWriteLabel(routine + "_return");
+            outputstream << "@R15\n";
+            outputstream << "A=M\n";
+            outputstream << "0;JMP\n";
+        }
+
+        routineSize += CountInstructions() - start;
+    }
+
+    void ReportSize(size_t rom)
+    {
+        if (options.sharedCompare)
+        {
+            int sites = 0;
+            for (const auto &[op, count] : compares)
+                sites += count;
+
+            std::cout << "shared compare: " << sites << " comparisons, "
+                      << compares.size() << " routines of " << routineSize << " instructions\n";
+        }
+
+        if (options.sharedCall)
+        {
+            std::cout << "shared call: " << calls << " calls, " << returns << " returns, "
+                      << "routines of " << callSize << " + " << returnSize << " instructions\n";
+        }
+
+        if (options.sharedCompare || options.sharedCall)
+            std::cout << "ROM " << rom << " instructions\n";
+    }
+
+    // instructions written so far, labels excluded
+    size_t CountInstructions()
+    {
+        const auto &text = outputstream.str();
+        size_t count = 0;
+        for (size_t begin = 0; begin < text.size();)
+        {
+            if (text[begin] != '(')
+                count++;
+            begin = text.find('\n', begin) + 1;
+        }
+
+        return count;
+    }
+
+    static bool IsCompare(Operator op)
+    {
+        return op == Operator::EQ || op == Operator::GT || op == Operator::LT;
+    }
+
+    static std::string JumpOf(Operator op)
+    {
+        if (op == Operator::EQ)
+            return "JEQ";
+        else if (op == Operator::GT)
+            return "JGT";
+        else
+            return "JLT";
+    }
+
+    static std::string CompareRoutine(Operator op)
+    {
+        if (op == Operator::EQ)
+            return "__compare_eq";
+        else if (op == Operator::GT)
+            return "__compare_gt";
+        else
+            return "__compare_lt";
+    }
+
+    // With options.cacheTop the top of the VM stack may live in D instead of
+    // RAM[SP-1]; `cached` says whether it currently does. Labels, jumps,
+    // calls and returns always see the whole stack in RAM.
+    void Spill()
+    {
+        if (!cached)
+            return;
+
+        PushDToSP();
+        cached = false;
+    }
+
+    void Fill()
+    {
+        if (cached)
+            return;
+
+        PopSPToD();
+        cached = true;
+    }
+
+    void WriteCachedOperator(Operator op)
+    {
+        Fill();
+
+        if (op == Operator::NEG)
+            outputstream << "D=-D\n";
+        else if (op == Operator::NOT)
+            outputstream << "D=!D\n";
+        else
+        {
+            // D=y, select x and pop it
+            outputstream << "@SP\n";
+            outputstream << "AM=M-1\n";
+
+            if (op == Operator::ADD)
+                outputstream << "D=D+M\n";
+            else if (op == Operator::SUB)
+                outputstream << "D=M-D\n";
+            else if (op == Operator::AND)
+                outputstream << "D=D&M\n";
+            else if (op == Operator::OR)
+                outputstream << "D=D|M\n";
+            else // eq gt lt
+            {
+                outputstream << "D=M-D\n";
+                auto to = NewLabel();
+                auto back = NewLabel();
+
+                auto jump = JumpOf(op);
+
+                AtLabel(to);
+                outputstream << "D;" << jump << "\n";
+                outputstream << "D=0\n";
+                Goto(back);
+
+                WriteLabel(to);
+                outputstream << "D=-1\n";
+
+                WriteLabel(back);
+            }
+        }
+    }
+
+    void WriteCachedPushPop(CommandType type, Segment segment, int index)
+    {
+        std::string base;
+        if (segment == Segment::LOCAL)
+            base = "LCL";
+        else if (segment == Segment::ARGUMENT)
+            base = "ARG";
+        else if (segment == Segment::THIS)
+            base = "THIS";
+        else if (segment == Segment::THAT)
+            base = "THAT";
+
+        std::string R;
+        if (segment == Segment::TEMP)
+            R = "R" + std::to_string(index + 5);
+        else if (segment == Segment::POINTER)
+            R = "R" + std::to_string(index + 3);
+        else if (segment == Segment::STATIC)
+            R = fileName + "." + std::to_string(index);
+
+        if (type == CommandType::C_PUSH)
+        {
+            Spill();
+
+            if (segment == Segment::CONSTANT)
+            {
+                if (index == 0 || index == 1)
+                    outputstream << "D=" << index << "\n";
+                else
+                {
+                    outputstream << "@" << index << "\n";
+                    outputstream << "D=A\n";
+                }
+            }
+            else if (!base.empty())
+            {
+                if (index == 0)
+                {
+                    outputstream << "@" << base << "\n";
+                    outputstream << "A=M\n";
+                }
+                else
+                {
+                    outputstream << "@" << index << "\n";
+                    outputstream << "D=A\n";
+                    outputstream << "@" << base << "\n";
+                    outputstream << "A=D+M\n";
+                }
+                outputstream << "D=M\n";
+            }
+            else
+            {
+                outputstream << "@" << R << "\n";
+                outputstream << "D=M\n";
+            }
+
+            cached = true;
+            return;
+        }
+
+        Fill();
+        cached = false;
+
+        if (base.empty())
+        {
+            outputstream << "@" << R << "\n";
+            outputstream << "M=D\n";
+        }
+        else if (index < 8)
+        {
+            // walk A up to base+index, D keeps the value
+            outputstream << "@" << base << "\n";
+            outputstream << "A=M\n";
+            for (int i = 0; i < index; i++)
+                outputstream << "A=A+1\n";
+            outputstream << "M=D\n";
+        }
+        else
+        {
+            outputstream << "@R14\n";
+            outputstream << "M=D\n";
+            outputstream << "@" << index << "\n";
+            outputstream << "D=A\n";
+            outputstream << "@" << base << "\n";
+            outputstream << "D=D+M\n";
+            outputstream << "@R13\n";
+            outputstream << "M=D\n";
+            outputstream << "@R14\n";
+            outputstream << "D=M\n";
+            outputstream << "@R13\n";
+            outputstream << "A=M\n";
+            outputstream << "M=D\n";
+        }
     }
 
-private:
     void SetFrameTo(const std::string &varname, int offset)
     {
         // varname = *(frame - offset)
         outputstream << "@R13\n";
         outputstream << "D=M\n";                             // D=frame
-        outputstream << "@" + std::to_string(offset) + "\n"; // A=offset
+        outputstream << "@" << offset << "\n";               // A=offset
         outputstream << "A=D-A\n";                           // select frame-offset
         outputstream << "D=M\n";                             // D=*(frame-offset)
-        outputstream << "@" + varname + "\n";
+        outputstream << "@" << varname << "\n";
         outputstream << "M=D\n";
     }
 
     void SetRegToSP(const std::string &reg)
     {
-        outputstream << "@" + reg + "\n";
+        outputstream << "@" << reg << "\n";
         outputstream << "D=M\n";
         PushDToSP();
     }
@@ -497,7 +1217,7 @@ private:
     void SetSP(int value)
     {
         SelectSP();
-        outputstream << "M=" + std::to_string(value) + "\n";
+        outputstream << "M=" << value << "\n";
     }
 
     int NewLabel()
@@ -505,9 +1225,10 @@ private:
         return label++;
     }
 
-    static std::string LabelName(int label)
+    // numbered per file, so files can be translated independently
+    std::string LabelName(int label) const
     {
-        return "Label" + std::to_string(label);
+        return fileName + "$Label" + std::to_string(label);
     }
 
     std::string GetFunctionLabel(const std::string &label)
@@ -525,7 +1246,7 @@ private:
 
     void AtLabel(const std::string &label)
     {
-        outputstream << "@" + label + "\n";
+        outputstream << "@" << label << "\n";
     }
 
     void AtLabel(int l)
@@ -540,7 +1261,7 @@ private:
 
     void InternalWriteLabel(const std::string &label)
     {
-        outputstream << "(" + label + ")\n";
+        outputstream << "(" << label << ")\n";
     }
 
     void Goto(const std::string &label)
@@ -556,27 +1277,102 @@ private:
     }
 
 private:
-    std::ofstream outputstream;
+    std::ofstream outputfile;
+    OutputBuffer outputstream;
+    TranslatorOptions options;
+    bool cached = false;
+    std::map<Operator, int> compares;
+    size_t routineSize = 0;
+    int calls = 0;
+    int returns = 0;
+    size_t callSize = 0;
+    size_t returnSize = 0;
     int label;
     std::string fileName;
     std::string functionName;
     int functionLabel;
 };
 
-void Run(Parser &parser, CodeWriter &writer)
+// Which function calls which, over every .vm file of a program. VM code
+// has no indirect calls, so everything reachable from the root is known.
+class CallGraph
+{
+public:
+    void Add(Parser &parser)
+    {
+        std::string current;
+        while (parser.HasMoreLines())
+        {
+            parser.Advance();
+            auto type = parser.GetCommandType();
+            if (type == CommandType::C_FUNCTION)
+            {
+                current = parser.Arg1();
+                functions.push_back(current);
+                calls[current];
+            }
+            else if (type == CommandType::C_CALL)
+                calls[current].insert(parser.Arg1());
+        }
+    }
+
+    std::set<std::string> Reachable(const std::string &root) const
+    {
+        std::set<std::string> live;
+        std::vector<std::string> pending{root};
+        while (!pending.empty())
+        {
+            auto function = pending.back();
+            pending.pop_back();
+            if (!live.insert(function).second)
+                continue;
+
+            auto it = calls.find(function);
+            if (it != calls.end())
+                pending.insert(pending.end(), it->second.begin(), it->second.end());
+        }
+
+        return live;
+    }
+
+    bool Contains(const std::string &function) const
+    {
+        return calls.find(function) != calls.end();
+    }
+
+    const std::vector<std::string> &Functions() const
+    {
+        return functions;
+    }
+
+private:
+    std::vector<std::string> functions;
+    std::map<std::string, std::set<std::string>> calls;
+};
+
+// live lists the functions to translate, every other function is skipped
+// up to the next function command. Without it everything is translated.
+void Run(Parser &parser, CodeWriter &writer, const std::set<std::string> *live = nullptr)
 {
+    bool skip = false;
     while (parser.HasMoreLines())
     {
         parser.Advance();
         auto type = parser.GetCommandType();
+        if (type == CommandType::C_FUNCTION)
+            skip = live && live->count(parser.Arg1()) == 0;
+
+        if (skip)
+            continue;
+
         switch (type)
         {
         case CommandType::C_ARITHMETIC:
-            writer.WriteOperator(parser.Arg1());
+            writer.WriteOperator(parser.GetOperator());
             break;
         case CommandType::C_PUSH:
         case CommandType::C_POP:
-            writer.WritePushPop(type, parser.Arg1(), std::stoi(parser.Arg2()));
+            writer.WritePushPop(type, parser.GetSegment(), parser.Arg2());
             break;
         case CommandType::C_LABEL:
             writer.WriteLabel(parser.Arg1());
@@ -588,13 +1384,13 @@ void Run(Parser &parser, CodeWriter &writer)
             writer.WriterGoto(parser.Arg1());
             break;
         case CommandType::C_FUNCTION:
-            writer.WriteFunction(parser.Arg1(), std::stoi(parser.Arg2()));
+            writer.WriteFunction(parser.Arg1(), parser.Arg2());
             break;
         case CommandType::C_RETURN:
             writer.WriteReturn();
             break;
         case CommandType::C_CALL:
-            writer.WriteCall(parser.Arg1(), std::stoi(parser.Arg2()));
+            writer.WriteCall(parser.Arg1(), parser.Arg2());
             break;
         default:
             throw "should not reach here...";
@@ -602,16 +1398,45 @@ void Run(Parser &parser, CodeWriter &writer)
     }
 }
 
-// g++ --std=c++17 -g -O0 translator.cc -o translator
+// g++ --std=c++17 -g -O0 -pthread translator.cc -o translator
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    std::string input;
+    TranslatorOptions options;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--peephole")
+            options.peephole = true;
+        else if (arg == "--cache-top")
+            options.cacheTop = true;
+        else if (arg == "--shared-compare")
+            options.sharedCompare = true;
+        else if (arg == "--shared-call")
+            options.sharedCall = true;
+        else if (arg == "--eliminate-dead")
+            options.eliminateDead = true;
+        else if (arg == "--profile")
+            options.profile = true;
+        else if (arg == "--jobs" && i + 1 < argc)
+            jobs = std::max(1, std::stoi(argv[++i]));
+        else if (input.empty())
+            input = arg;
+        else
+        {
+            input.clear();
+            break;
+        }
+    }
+
+    if (input.empty())
     {
-        std::cout << "Usage: /bin /path/to/input/file\n";
+        std::cout << "Usage: /bin [--peephole] [--cache-top] [--shared-compare] [--shared-call] [--eliminate-dead] [--profile] [--jobs N] /path/to/input/file\n";
         return 0;
     }
 
-    std::filesystem::path input_filename(argv[1]);
+    std::filesystem::path input_filename(input);
 
     std::filesystem::path dir;
     std::filesystem::path output_filename;
@@ -631,19 +1456,103 @@ int main(int argc, char *argv[])
         dir = input_filename.parent_path();
     }
 
-    CodeWriter writer(output_filename);
-    if (needInit)
-        writer.Init();
-
+    std::vector<std::filesystem::path> paths;
     for (const auto &entry : std::filesystem::directory_iterator(dir))
     {
-        auto path = entry.path();
-        if (path.extension() != ".vm")
-            continue;
+        if (entry.path().extension() == ".vm")
+            paths.push_back(entry.path());
+    }
+
+    // directory order differs between file systems
+    std::sort(paths.begin(), paths.end());
+
+    std::set<std::string> live;
+    bool eliminate = false;
+    CallGraph graph;
+    if (options.eliminateDead || options.profile)
+    {
+        for (const auto &path : paths)
+        {
+            Parser parser(path.string());
+            graph.Add(parser);
+        }
+    }
+
+    if (options.eliminateDead)
+    {
+        // without a Sys.init there is no root to start from
+        eliminate = needInit && graph.Contains("Sys.init");
+        if (eliminate)
+        {
+            live = graph.Reachable("Sys.init");
 
-        Parser parser(path.string());
-        writer.SetFileName(path.stem());
+            std::vector<std::string> removed;
+            for (const auto &function : graph.Functions())
+            {
+                if (live.count(function) == 0)
+                    removed.push_back(function);
+            }
+
+            std::cout << "dead functions: " << removed.size() << " of "
+                      << graph.Functions().size() << " removed\n";
+            for (const auto &function : removed)
+                std::cout << "    " << function << "\n";
+        }
+        else
+            std::cout << "dead functions: no Sys.init, nothing removed\n";
+    }
+
+    // one counter per translated function, listed in <program>.profile
+    // for profile.sh to read back from a RAM dump
+    if (options.profile)
+    {
+        std::vector<std::string> counted;
+        for (const auto &function : graph.Functions())
+        {
+            if (!eliminate || live.count(function))
+                counted.push_back(function);
+        }
+
+        auto address = PROFILE_END - 2 * static_cast<int>(counted.size());
+        std::ofstream map(std::filesystem::path(output_filename).replace_extension(".profile"));
+        for (const auto &function : counted)
+        {
+            options.counters[function] = address;
+            map << address << " " << function << "\n";
+            address += 2;
+        }
 
-        Run(parser, writer);
+        std::cout << "profile: " << counted.size() << " counters at "
+                  << PROFILE_END - 2 * counted.size() << "-" << PROFILE_END - 1 << "\n";
     }
+
+    // every file into its own writer, then appended in sorted order
+    std::deque<CodeWriter> parts;
+    for (size_t i = 0; i < paths.size(); i++)
+        parts.emplace_back(options);
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        for (auto i = next++; i < paths.size(); i = next++)
+        {
+            Parser parser(paths[i].string());
+            parts[i].SetFileName(paths[i].stem());
+
+            Run(parser, parts[i], eliminate ? &live : nullptr);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < jobs; i++)
+        threads.emplace_back(worker);
+    for (auto &thread : threads)
+        thread.join();
+
+    CodeWriter writer(output_filename, options);
+    if (needInit)
+        writer.Init();
+
+    for (auto &part : parts)
+        writer.Append(part);
 }
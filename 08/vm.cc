@@ -0,0 +1,1495 @@
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+
+static constexpr int SP = 0;
+static constexpr int LCL = 1;
+static constexpr int ARG = 2;
+static constexpr int THIS = 3;
+static constexpr int THAT = 4;
+static constexpr int TEMP = 5;
+static constexpr int STATIC = 16;
+static constexpr int HEAP = 2048;
+static constexpr int SCREEN = 16384;
+static constexpr int KBD = 24576;
+
+enum class Op : uint8_t
+{
+    PUSH,
+    POP,
+    ADD,
+    SUB,
+    NEG,
+    EQ,
+    GT,
+    LT,
+    AND,
+    OR,
+    NOT,
+    GOTO,
+    IF_GOTO,
+    FUNCTION,
+    CALL,
+    CALL_BUILTIN,
+    RETURN,
+    HALT,
+};
+
+enum class Segment : uint8_t
+{
+    NONE,
+    CONSTANT,
+    LOCAL,
+    ARGUMENT,
+    THIS,
+    THAT,
+    TEMP,
+    POINTER,
+    STATIC,
+};
+
+static const std::map<std::string, Op, std::less<>> operators = {
+    {"add", Op::ADD},
+    {"sub", Op::SUB},
+    {"neg", Op::NEG},
+    {"eq", Op::EQ},
+    {"gt", Op::GT},
+    {"lt", Op::LT},
+    {"and", Op::AND},
+    {"or", Op::OR},
+    {"not", Op::NOT},
+    {"push", Op::PUSH},
+    {"pop", Op::POP},
+    {"goto", Op::GOTO},
+    {"if-goto", Op::IF_GOTO},
+    {"function", Op::FUNCTION},
+    {"call", Op::CALL},
+    {"return", Op::RETURN},
+};
+
+static const std::map<std::string, Segment, std::less<>> segments = {
+    {"constant", Segment::CONSTANT},
+    {"local", Segment::LOCAL},
+    {"argument", Segment::ARGUMENT},
+    {"this", Segment::THIS},
+    {"that", Segment::THAT},
+    {"temp", Segment::TEMP},
+    {"pointer", Segment::POINTER},
+    {"static", Segment::STATIC},
+};
+
+// The OS functions the machine provides itself for every OS class that has
+// no .vm file loaded, like the VM emulator of the course does.
+enum class Builtin
+{
+    MATH_INIT,
+    MATH_ABS,
+    MATH_MULTIPLY,
+    MATH_DIVIDE,
+    MATH_MIN,
+    MATH_MAX,
+    MATH_SQRT,
+    MEMORY_INIT,
+    MEMORY_PEEK,
+    MEMORY_POKE,
+    MEMORY_ALLOC,
+    MEMORY_DEALLOC,
+    ARRAY_NEW,
+    ARRAY_DISPOSE,
+    STRING_NEW,
+    STRING_DISPOSE,
+    STRING_LENGTH,
+    STRING_CHARAT,
+    STRING_SETCHARAT,
+    STRING_APPENDCHAR,
+    STRING_ERASELASTCHAR,
+    STRING_INTVALUE,
+    STRING_SETINT,
+    STRING_NEWLINE,
+    STRING_BACKSPACE,
+    STRING_DOUBLEQUOTE,
+    OUTPUT_INIT,
+    OUTPUT_MOVECURSOR,
+    OUTPUT_PRINTCHAR,
+    OUTPUT_PRINTSTRING,
+    OUTPUT_PRINTINT,
+    OUTPUT_PRINTLN,
+    OUTPUT_BACKSPACE,
+    SCREEN_INIT,
+    SCREEN_CLEARSCREEN,
+    SCREEN_SETCOLOR,
+    SCREEN_DRAWPIXEL,
+    SCREEN_DRAWLINE,
+    SCREEN_DRAWRECTANGLE,
+    SCREEN_DRAWCIRCLE,
+    KEYBOARD_INIT,
+    KEYBOARD_KEYPRESSED,
+    KEYBOARD_READCHAR,
+    KEYBOARD_READLINE,
+    KEYBOARD_READINT,
+    SYS_HALT,
+    SYS_ERROR,
+    SYS_WAIT,
+};
+
+static const std::map<std::string, Builtin> builtins = {
+    {"Math.init", Builtin::MATH_INIT},
+    {"Math.abs", Builtin::MATH_ABS},
+    {"Math.multiply", Builtin::MATH_MULTIPLY},
+    {"Math.divide", Builtin::MATH_DIVIDE},
+    {"Math.min", Builtin::MATH_MIN},
+    {"Math.max", Builtin::MATH_MAX},
+    {"Math.sqrt", Builtin::MATH_SQRT},
+    {"Memory.init", Builtin::MEMORY_INIT},
+    {"Memory.peek", Builtin::MEMORY_PEEK},
+    {"Memory.poke", Builtin::MEMORY_POKE},
+    {"Memory.alloc", Builtin::MEMORY_ALLOC},
+    {"Memory.deAlloc", Builtin::MEMORY_DEALLOC},
+    {"Array.new", Builtin::ARRAY_NEW},
+    {"Array.dispose", Builtin::ARRAY_DISPOSE},
+    {"String.new", Builtin::STRING_NEW},
+    {"String.dispose", Builtin::STRING_DISPOSE},
+    {"String.length", Builtin::STRING_LENGTH},
+    {"String.charAt", Builtin::STRING_CHARAT},
+    {"String.setCharAt", Builtin::STRING_SETCHARAT},
+    {"String.appendChar", Builtin::STRING_APPENDCHAR},
+    {"String.eraseLastChar", Builtin::STRING_ERASELASTCHAR},
+    {"String.intValue", Builtin::STRING_INTVALUE},
+    {"String.setInt", Builtin::STRING_SETINT},
+    {"String.newLine", Builtin::STRING_NEWLINE},
+    {"String.backSpace", Builtin::STRING_BACKSPACE},
+    {"String.doubleQuote", Builtin::STRING_DOUBLEQUOTE},
+    {"Output.init", Builtin::OUTPUT_INIT},
+    {"Output.moveCursor", Builtin::OUTPUT_MOVECURSOR},
+    {"Output.printChar", Builtin::OUTPUT_PRINTCHAR},
+    {"Output.printString", Builtin::OUTPUT_PRINTSTRING},
+    {"Output.printInt", Builtin::OUTPUT_PRINTINT},
+    {"Output.println", Builtin::OUTPUT_PRINTLN},
+    {"Output.backSpace", Builtin::OUTPUT_BACKSPACE},
+    {"Screen.init", Builtin::SCREEN_INIT},
+    {"Screen.clearScreen", Builtin::SCREEN_CLEARSCREEN},
+    {"Screen.setColor", Builtin::SCREEN_SETCOLOR},
+    {"Screen.drawPixel", Builtin::SCREEN_DRAWPIXEL},
+    {"Screen.drawLine", Builtin::SCREEN_DRAWLINE},
+    {"Screen.drawRectangle", Builtin::SCREEN_DRAWRECTANGLE},
+    {"Screen.drawCircle", Builtin::SCREEN_DRAWCIRCLE},
+    {"Keyboard.init", Builtin::KEYBOARD_INIT},
+    {"Keyboard.keyPressed", Builtin::KEYBOARD_KEYPRESSED},
+    {"Keyboard.readChar", Builtin::KEYBOARD_READCHAR},
+    {"Keyboard.readLine", Builtin::KEYBOARD_READLINE},
+    {"Keyboard.readInt", Builtin::KEYBOARD_READINT},
+    {"Sys.halt", Builtin::SYS_HALT},
+    {"Sys.error", Builtin::SYS_ERROR},
+    {"Sys.wait", Builtin::SYS_WAIT},
+};
+
+// OS classes whose init the generated Sys.init calls, in this order
+static const std::vector<std::string> osClasses = {"Memory", "Math", "Screen", "Output", "Keyboard"};
+
+// One loaded VM command. Labels are gone, jumps and calls hold the index
+// of their target and static variables their RAM address.
+struct Instruction
+{
+    Op op;
+    Segment segment = Segment::NONE;
+    int arg = 0;    // push/pop index or address, nVars, nArgs
+    int target = 0; // jump or call target, builtin id
+};
+
+// An operand of a lowered instruction: a constant, a fixed RAM address
+// (temp, pointer, static) or a slot at an index from LCL, ARG, THIS or THAT.
+struct Operand
+{
+    enum Kind : uint8_t
+    {
+        CONSTANT,
+        DIRECT,
+        INDIRECT,
+    };
+
+    Kind kind = CONSTANT;
+    uint8_t base = 0;
+    int16_t value = 0;
+};
+
+// Superinstructions the loader fuses common command sequences into.
+enum class Fused : uint8_t
+{
+    PUSH,         // push x
+    POP,          // pop z
+    UNARY,        // neg, not
+    BINARY_STACK, // add, sub, ... on the two top values
+    BINARY_TOP,   // push y; op
+    BINARY,       // push x; push y; op
+    BINARY_STORE, // push x; push y; op; pop z
+    MOVE,         // push x; pop z
+    BRANCH,       // push x; push y; op; [not;] if-goto
+    IF_NOT,       // not; if-goto
+    GOTO,
+    IF_GOTO,
+    FUNCTION,
+    CALL,
+    CALL_BUILTIN,
+    RETURN,
+    HALT,
+};
+
+struct Lowered
+{
+    Fused op;
+    Op arith = Op::ADD;
+    bool negate = false; // BRANCH jumps when not of the result is true
+    uint8_t count = 1;   // VM commands it stands for
+    Operand x = {}, y = {}, z = {};
+    int arg = 0;
+    int target = 0;
+};
+
+class Parser
+{
+public:
+    Parser(const std::string &filename)
+        : inputstream(filename) {}
+
+    ~Parser()
+    {
+        inputstream.close();
+    }
+
+    bool HasMoreLines()
+    {
+        return inputstream.peek() != EOF;
+    }
+
+    // returns false for a file ending in blank lines or comments
+    bool Advance()
+    {
+        while (std::getline(inputstream, line))
+        {
+            boost::trim(line);
+            if (line.empty() || line.substr(0, 2) == "//")
+                continue;
+
+            auto pos = line.find("//");
+            if (pos != std::string::npos)
+            {
+                line = line.substr(0, pos);
+                boost::trim(line);
+            }
+
+            break;
+        }
+
+        std::string_view rest(line);
+        for (auto &word : words)
+        {
+            while (!rest.empty() && std::isspace(static_cast<unsigned char>(rest.front())))
+                rest.remove_prefix(1);
+
+            auto end = std::min(rest.find_first_of(" \t"), rest.size());
+            word = rest.substr(0, end);
+            rest.remove_prefix(end);
+        }
+
+        return !words[0].empty();
+    }
+
+    std::string_view Command() const
+    {
+        return words[0];
+    }
+
+    std::string_view Arg1() const
+    {
+        return words[1];
+    }
+
+    int Arg2() const
+    {
+        int value = 0;
+        auto word = words[2];
+        auto result = std::from_chars(word.data(), word.data() + word.size(), value);
+        if (result.ec != std::errc() || result.ptr != word.data() + word.size())
+            throw "should not reach here...";
+
+        return value;
+    }
+
+private:
+    std::ifstream inputstream;
+    std::string line;
+    std::string_view words[3];
+};
+
+class VirtualMachine
+{
+public:
+    VirtualMachine()
+        : ram(32768)
+    {
+        Reset();
+    }
+
+    // Loads every file in the given order. Static variables get RAM
+    // addresses from 16 on in order of first use, like the assembler does.
+    void Load(const std::vector<std::filesystem::path> &paths)
+    {
+        for (const auto &path : paths)
+        {
+            auto fileName = path.stem().string();
+            std::string functionName;
+
+            Parser parser(path.string());
+            while (parser.HasMoreLines())
+            {
+                if (!parser.Advance())
+                    break;
+
+                auto command = parser.Command();
+                if (command == "label")
+                {
+                    labels[FunctionLabel(functionName, parser.Arg1())] = program.size();
+                    continue;
+                }
+
+                auto op = operators.find(command);
+                if (op == operators.end())
+                    throw "should not reach here...";
+
+                Instruction instruction{op->second};
+                switch (instruction.op)
+                {
+                case Op::PUSH:
+                case Op::POP:
+                {
+                    auto segment = segments.find(parser.Arg1());
+                    if (segment == segments.end())
+                        throw "should not reach here...";
+
+                    instruction.segment = segment->second;
+                    instruction.arg = parser.Arg2();
+                    if (instruction.segment == Segment::STATIC)
+                        instruction.arg = StaticAddress(fileName + "." + std::to_string(instruction.arg));
+                    break;
+                }
+                case Op::GOTO:
+                case Op::IF_GOTO:
+                    jumps.emplace_back(program.size(), FunctionLabel(functionName, parser.Arg1()));
+                    break;
+                case Op::FUNCTION:
+                    functionName = parser.Arg1();
+                    functions[functionName] = program.size();
+                    loadedClasses.insert(ClassOf(functionName));
+                    instruction.arg = parser.Arg2();
+                    break;
+                case Op::CALL:
+                    calls.emplace_back(program.size(), std::string(parser.Arg1()));
+                    instruction.arg = parser.Arg2();
+                    break;
+                default:
+                    break;
+                }
+
+                program.push_back(instruction);
+            }
+        }
+
+        // running off the end of a single file ends the run
+        program.push_back({Op::HALT});
+    }
+
+    // Sets SP and calls Sys.init, which returns into a halt. Without a
+    // Sys.init one is generated that initializes the loaded OS classes and
+    // runs Main.main.
+    void Bootstrap()
+    {
+        if (functions.count("Sys.init") == 0)
+        {
+            functions["Sys.init"] = program.size();
+            program.push_back({Op::FUNCTION, Segment::NONE, 0});
+            for (const auto &name : osClasses)
+            {
+                if (functions.count(name + ".init"))
+                    Call(name + ".init", 0);
+            }
+            Call("Main.main", 0);
+            Call("Sys.halt", 0);
+        }
+
+        entry = program.size();
+        Call("Sys.init", 0);
+        program.push_back({Op::HALT});
+    }
+
+    // Points every jump at its label and every call at its function, or at
+    // the builtin of an OS class that is not loaded.
+    void Link()
+    {
+        for (const auto &[index, label] : jumps)
+        {
+            auto it = labels.find(label);
+            if (it == labels.end())
+                throw std::string("unknown label ") + label;
+            program[index].target = it->second;
+        }
+
+        for (const auto &[index, name] : calls)
+        {
+            auto it = functions.find(name);
+            if (it != functions.end())
+            {
+                program[index].target = it->second;
+                continue;
+            }
+
+            auto builtin = builtins.find(name);
+            if (builtin == builtins.end() || loadedClasses.count(ClassOf(name)))
+                throw std::string("unknown function ") + name;
+
+            program[index].op = Op::CALL_BUILTIN;
+            program[index].target = static_cast<int>(builtin->second);
+        }
+    }
+
+    // Clears RAM, the heap and the counters for a new run from the start.
+    void Reset()
+    {
+        std::fill(ram.begin(), ram.end(), 0);
+        if (entry != 0)
+            ram[SP] = 256;
+
+        freeBlocks.clear();
+        freeBlocks[HEAP] = SCREEN - HEAP;
+        usedBlocks.clear();
+        text.clear();
+        color = true;
+        pc = fused ? loweredIndex[entry] : entry;
+        halted = false;
+        frames = 0;
+    }
+
+    // Builds the fused program: push and pop operands are resolved to
+    // constants, addresses or base+index slots, and the sequences listed in
+    // Fused become one instruction each. A sequence is only fused when no
+    // jump, call or return lands inside it.
+    void Lower()
+    {
+        std::vector<bool> isTarget(program.size() + 1);
+        isTarget[entry] = true;
+        for (const auto &[label, index] : labels)
+            isTarget[index] = true;
+        for (const auto &[name, index] : functions)
+            isTarget[index] = true;
+        for (size_t i = 0; i < program.size(); i++)
+        {
+            if (program[i].op == Op::CALL || program[i].op == Op::CALL_BUILTIN)
+                isTarget[i + 1] = true;
+        }
+
+        // the next n commands after i exist and none of them is a target
+        auto fits = [&](size_t i, size_t n)
+        {
+            if (i + n > program.size())
+                return false;
+            for (size_t j = i + 1; j < i + n; j++)
+            {
+                if (isTarget[j])
+                    return false;
+            }
+            return true;
+        };
+        auto is = [&](size_t i, Op op)
+        {
+            return i < program.size() && program[i].op == op;
+        };
+        auto isBinary = [&](size_t i)
+        {
+            return i < program.size() && program[i].op >= Op::ADD && program[i].op <= Op::OR &&
+                   program[i].op != Op::NEG;
+        };
+
+        lowered.clear();
+        loweredIndex.assign(program.size() + 1, -1);
+        for (size_t i = 0; i < program.size();)
+        {
+            loweredIndex[i] = lowered.size();
+            const auto &instruction = program[i];
+
+            Lowered l{Fused::PUSH};
+            if (is(i, Op::PUSH) && is(i + 1, Op::PUSH) && isBinary(i + 2) && fits(i, 4) && is(i + 3, Op::POP))
+            {
+                l = {Fused::BINARY_STORE, program[i + 2].op};
+                l.count = 4;
+                l.x = ToOperand(program[i]);
+                l.y = ToOperand(program[i + 1]);
+                l.z = ToOperand(program[i + 3]);
+            }
+            else if (is(i, Op::PUSH) && is(i + 1, Op::PUSH) && isBinary(i + 2) && is(i + 3, Op::NOT) &&
+                     is(i + 4, Op::IF_GOTO) && fits(i, 5))
+            {
+                l = {Fused::BRANCH, program[i + 2].op, true};
+                l.count = 5;
+                l.target = program[i + 4].target;
+            }
+            else if (is(i, Op::PUSH) && is(i + 1, Op::PUSH) && isBinary(i + 2) && is(i + 3, Op::IF_GOTO) && fits(i, 4))
+            {
+                l = {Fused::BRANCH, program[i + 2].op};
+                l.count = 4;
+                l.target = program[i + 3].target;
+            }
+            else if (is(i, Op::PUSH) && is(i + 1, Op::PUSH) && isBinary(i + 2) && fits(i, 3))
+            {
+                l = {Fused::BINARY, program[i + 2].op};
+                l.count = 3;
+            }
+            else if (is(i, Op::PUSH) && is(i + 1, Op::POP) && fits(i, 2))
+            {
+                l = {Fused::MOVE};
+                l.count = 2;
+                l.x = ToOperand(program[i]);
+                l.z = ToOperand(program[i + 1]);
+            }
+            else if (is(i, Op::PUSH) && isBinary(i + 1) && fits(i, 2))
+            {
+                l = {Fused::BINARY_TOP, program[i + 1].op};
+                l.count = 2;
+                l.y = ToOperand(program[i]);
+            }
+            else if (is(i, Op::NOT) && is(i + 1, Op::IF_GOTO) && fits(i, 2))
+            {
+                l = {Fused::IF_NOT};
+                l.count = 2;
+                l.target = program[i + 1].target;
+            }
+            else
+            {
+                switch (instruction.op)
+                {
+                case Op::PUSH:
+                    l = {Fused::PUSH};
+                    l.x = ToOperand(instruction);
+                    break;
+                case Op::POP:
+                    l = {Fused::POP};
+                    l.z = ToOperand(instruction);
+                    break;
+                case Op::NEG:
+                case Op::NOT:
+                    l = {Fused::UNARY, instruction.op};
+                    break;
+                case Op::GOTO:
+                    l = {Fused::GOTO};
+                    break;
+                case Op::IF_GOTO:
+                    l = {Fused::IF_GOTO};
+                    break;
+                case Op::FUNCTION:
+                    l = {Fused::FUNCTION};
+                    break;
+                case Op::CALL:
+                    l = {Fused::CALL};
+                    break;
+                case Op::CALL_BUILTIN:
+                    l = {Fused::CALL_BUILTIN};
+                    break;
+                case Op::RETURN:
+                    l = {Fused::RETURN};
+                    break;
+                case Op::HALT:
+                    l = {Fused::HALT};
+                    break;
+                default:
+                    l = {Fused::BINARY_STACK, instruction.op};
+                    break;
+                }
+                l.arg = instruction.arg;
+                l.target = instruction.target;
+            }
+
+            if (l.op == Fused::BRANCH || l.op == Fused::BINARY)
+            {
+                l.x = ToOperand(program[i]);
+                l.y = ToOperand(program[i + 1]);
+            }
+
+            lowered.push_back(l);
+            i += l.count;
+        }
+
+        // jumps and calls move to the fused indices
+        for (auto &l : lowered)
+        {
+            if (l.op == Fused::GOTO || l.op == Fused::IF_GOTO || l.op == Fused::IF_NOT ||
+                l.op == Fused::BRANCH || l.op == Fused::CALL)
+                l.target = loweredIndex[l.target];
+        }
+
+        fused = true;
+        pc = loweredIndex[entry];
+    }
+
+    // Same machine as Run over the fused program.
+    uint64_t RunFused(uint64_t maxCycles)
+    {
+        uint64_t cycles = 0;
+        halted = false;
+        while (!halted && cycles < maxCycles)
+        {
+            const auto &l = lowered[pc++];
+            cycles += l.count;
+
+            switch (l.op)
+            {
+            case Fused::PUSH:
+                Push(Load(l.x));
+                break;
+            case Fused::POP:
+            {
+                auto address = Address(l.z);
+                ram[address] = Pop();
+                break;
+            }
+            case Fused::UNARY:
+                Top() = l.arith == Op::NEG ? -Top() : ~Top();
+                break;
+            case Fused::BINARY_STACK:
+            {
+                auto y = Pop();
+                Top() = Arith(l.arith, Top(), y);
+                break;
+            }
+            case Fused::BINARY_TOP:
+                Top() = Arith(l.arith, Top(), Load(l.y));
+                break;
+            case Fused::BINARY:
+            {
+                auto x = Load(l.x);
+                Push(Arith(l.arith, x, Load(l.y)));
+                break;
+            }
+            case Fused::BINARY_STORE:
+            {
+                auto x = Load(l.x);
+                auto value = Arith(l.arith, x, Load(l.y));
+                ram[Address(l.z)] = value;
+                break;
+            }
+            case Fused::MOVE:
+            {
+                auto value = Load(l.x);
+                ram[Address(l.z)] = value;
+                break;
+            }
+            case Fused::BRANCH:
+            {
+                // not is bitwise, so ~result is true unless result is -1
+                auto x = Load(l.x);
+                auto result = Arith(l.arith, x, Load(l.y));
+                if (l.negate ? result != -1 : result != 0)
+                    pc = l.target;
+                break;
+            }
+            case Fused::IF_NOT:
+                if (Pop() != -1)
+                    pc = l.target;
+                break;
+            case Fused::GOTO:
+                if (l.target == pc - 1)
+                    halted = true;
+                pc = l.target;
+                break;
+            case Fused::IF_GOTO:
+                if (Pop() != 0)
+                    pc = l.target;
+                break;
+            case Fused::FUNCTION:
+                for (int i = 0; i < l.arg; i++)
+                    Push(0);
+                break;
+            case Fused::CALL:
+                Push(pc);
+                Push(ram[LCL]);
+                Push(ram[ARG]);
+                Push(ram[THIS]);
+                Push(ram[THAT]);
+                ram[ARG] = ram[SP] - 5 - l.arg;
+                ram[LCL] = ram[SP];
+                pc = l.target;
+                break;
+            case Fused::CALL_BUILTIN:
+            {
+                ram[SP] -= l.arg;
+                auto value = CallBuiltin(static_cast<Builtin>(l.target), &ram[Mask(ram[SP])]);
+                Push(value);
+                break;
+            }
+            case Fused::RETURN:
+                Return(lowered.size());
+                break;
+            case Fused::HALT:
+                pc--;
+                cycles--;
+                halted = true;
+                break;
+            }
+        }
+
+        return cycles;
+    }
+
+    // Runs until a halt, an endless `goto` to itself, maxCycles commands or
+    // maxFrames calls of Sys.wait. Returns the number of commands run.
+    uint64_t Run(uint64_t maxCycles)
+    {
+        uint64_t cycles = 0;
+        halted = false;
+        while (!halted && cycles < maxCycles)
+        {
+            const auto &instruction = program[pc++];
+            cycles++;
+
+            switch (instruction.op)
+            {
+            case Op::PUSH:
+                Push(instruction.segment == Segment::CONSTANT ? instruction.arg : ram[Address(instruction)]);
+                break;
+            case Op::POP:
+            {
+                // the address is taken before SP moves, as the translator does
+                auto address = Address(instruction);
+                ram[address] = Pop();
+                break;
+            }
+            case Op::ADD:
+            {
+                auto y = Pop();
+                Top() = Top() + y;
+                break;
+            }
+            case Op::SUB:
+            {
+                auto y = Pop();
+                Top() = Top() - y;
+                break;
+            }
+            case Op::NEG:
+                Top() = -Top();
+                break;
+            case Op::EQ:
+            {
+                auto y = Pop();
+                Top() = Top() == y ? -1 : 0;
+                break;
+            }
+            case Op::GT:
+            {
+                auto y = Pop();
+                Top() = static_cast<int16_t>(Top() - y) > 0 ? -1 : 0;
+                break;
+            }
+            case Op::LT:
+            {
+                auto y = Pop();
+                Top() = static_cast<int16_t>(Top() - y) < 0 ? -1 : 0;
+                break;
+            }
+            case Op::AND:
+            {
+                auto y = Pop();
+                Top() = Top() & y;
+                break;
+            }
+            case Op::OR:
+            {
+                auto y = Pop();
+                Top() = Top() | y;
+                break;
+            }
+            case Op::NOT:
+                Top() = ~Top();
+                break;
+            case Op::GOTO:
+                if (instruction.target == pc - 1)
+                    halted = true;
+                pc = instruction.target;
+                break;
+            case Op::IF_GOTO:
+                if (Pop() != 0)
+                    pc = instruction.target;
+                break;
+            case Op::FUNCTION:
+                for (int i = 0; i < instruction.arg; i++)
+                    Push(0);
+                break;
+            case Op::CALL:
+                Push(pc);
+                Push(ram[LCL]);
+                Push(ram[ARG]);
+                Push(ram[THIS]);
+                Push(ram[THAT]);
+                ram[ARG] = ram[SP] - 5 - instruction.arg;
+                ram[LCL] = ram[SP];
+                pc = instruction.target;
+                break;
+            case Op::CALL_BUILTIN:
+            {
+                ram[SP] -= instruction.arg;
+                auto value = CallBuiltin(static_cast<Builtin>(instruction.target), &ram[Mask(ram[SP])]);
+                Push(value);
+                break;
+            }
+            case Op::RETURN:
+                Return(program.size());
+                break;
+            case Op::HALT:
+                pc--;
+                cycles--;
+                halted = true;
+                break;
+            }
+        }
+
+        return cycles;
+    }
+
+    bool HasFunction(const std::string &name) const
+    {
+        return functions.count(name) > 0;
+    }
+
+    int16_t Read(int address) const
+    {
+        return ram[Mask(address)];
+    }
+
+    void Write(int address, int16_t value)
+    {
+        ram[Mask(address)] = value;
+    }
+
+    void SetMaxFrames(uint64_t frames)
+    {
+        maxFrames = frames;
+    }
+
+    uint64_t Frames() const
+    {
+        return frames;
+    }
+
+    const std::string &Text() const
+    {
+        return text;
+    }
+
+    void DumpRAM(std::ostream &output) const
+    {
+        for (auto value : ram)
+            output << value << "\n";
+    }
+
+    // 512x256 screen as a plain PBM image
+    void DumpScreen(std::ostream &output) const
+    {
+        output << "P1\n512 256\n";
+        for (int row = 0; row < 256; row++)
+        {
+            for (int col = 0; col < 512; col++)
+                output << ((ram[SCREEN + row * 32 + col / 16] >> (col % 16)) & 1);
+            output << "\n";
+        }
+    }
+
+private:
+    static int Mask(int address)
+    {
+        return static_cast<uint16_t>(address) & 0x7FFF;
+    }
+
+    static std::string ClassOf(const std::string &functionName)
+    {
+        return functionName.substr(0, functionName.find('.'));
+    }
+
+    static std::string FunctionLabel(const std::string &functionName, std::string_view label)
+    {
+        if (functionName.empty())
+            return std::string(label);
+
+        return functionName + "$" + std::string(label);
+    }
+
+    int StaticAddress(const std::string &name)
+    {
+        auto it = statics.find(name);
+        if (it != statics.end())
+            return it->second;
+
+        int address = STATIC + statics.size();
+        statics[name] = address;
+        return address;
+    }
+
+    void Call(const std::string &name, int nArgs)
+    {
+        calls.emplace_back(program.size(), name);
+        program.push_back({Op::CALL, Segment::NONE, nArgs});
+        program.push_back({Op::POP, Segment::TEMP, 0});
+    }
+
+    // size is the length of the running program
+    void Return(size_t size)
+    {
+        auto frame = Mask(ram[LCL]);
+        auto retAddr = static_cast<uint16_t>(ram[Mask(frame - 5)]);
+        ram[Mask(ram[ARG])] = Pop();
+        ram[SP] = ram[ARG] + 1;
+        ram[THAT] = ram[Mask(frame - 1)];
+        ram[THIS] = ram[Mask(frame - 2)];
+        ram[ARG] = ram[Mask(frame - 3)];
+        ram[LCL] = ram[Mask(frame - 4)];
+        pc = retAddr;
+
+        // a frame the program did not push, as the tests set up
+        if (pc >= static_cast<int>(size))
+        {
+            pc = size - 1;
+            halted = true;
+        }
+    }
+
+    static int16_t Arith(Op op, int16_t x, int16_t y)
+    {
+        switch (op)
+        {
+        case Op::ADD:
+            return x + y;
+        case Op::SUB:
+            return x - y;
+        case Op::EQ:
+            return x == y ? -1 : 0;
+        case Op::GT:
+            return static_cast<int16_t>(x - y) > 0 ? -1 : 0;
+        case Op::LT:
+            return static_cast<int16_t>(x - y) < 0 ? -1 : 0;
+        case Op::AND:
+            return x & y;
+        case Op::OR:
+            return x | y;
+        default:
+            throw "should not reach here...";
+        }
+    }
+
+    static Operand ToOperand(const Instruction &instruction)
+    {
+        Operand operand;
+        operand.value = instruction.arg;
+        switch (instruction.segment)
+        {
+        case Segment::CONSTANT:
+            operand.kind = Operand::CONSTANT;
+            break;
+        case Segment::LOCAL:
+        case Segment::ARGUMENT:
+        case Segment::THIS:
+        case Segment::THAT:
+            operand.kind = Operand::INDIRECT;
+            operand.base = static_cast<int>(instruction.segment) - static_cast<int>(Segment::LOCAL) + LCL;
+            break;
+        case Segment::TEMP:
+            operand.kind = Operand::DIRECT;
+            operand.value = TEMP + instruction.arg;
+            break;
+        case Segment::POINTER:
+            operand.kind = Operand::DIRECT;
+            operand.value = THIS + instruction.arg;
+            break;
+        case Segment::STATIC:
+            operand.kind = Operand::DIRECT;
+            break;
+        default:
+            throw "should not reach here...";
+        }
+
+        return operand;
+    }
+
+    int Address(const Operand &operand) const
+    {
+        if (operand.kind == Operand::DIRECT)
+            return operand.value;
+
+        return Mask(ram[operand.base] + operand.value);
+    }
+
+    int16_t Load(const Operand &operand) const
+    {
+        if (operand.kind == Operand::CONSTANT)
+            return operand.value;
+
+        return ram[Address(operand)];
+    }
+
+    int Address(const Instruction &instruction) const
+    {
+        switch (instruction.segment)
+        {
+        case Segment::LOCAL:
+            return Mask(ram[LCL] + instruction.arg);
+        case Segment::ARGUMENT:
+            return Mask(ram[ARG] + instruction.arg);
+        case Segment::THIS:
+            return Mask(ram[THIS] + instruction.arg);
+        case Segment::THAT:
+            return Mask(ram[THAT] + instruction.arg);
+        case Segment::TEMP:
+            return TEMP + instruction.arg;
+        case Segment::POINTER:
+            return THIS + instruction.arg;
+        case Segment::STATIC:
+            return instruction.arg;
+        default:
+            throw "should not reach here...";
+        }
+    }
+
+    void Push(int16_t value)
+    {
+        ram[Mask(ram[SP]++)] = value;
+    }
+
+    int16_t Pop()
+    {
+        return ram[Mask(--ram[SP])];
+    }
+
+    int16_t &Top()
+    {
+        return ram[Mask(ram[SP] - 1)];
+    }
+
+    int16_t Alloc(int size)
+    {
+        size = std::max(size, 1);
+        for (auto &[address, free] : freeBlocks)
+        {
+            if (free < size)
+                continue;
+
+            int block = address;
+            if (free > size)
+                freeBlocks[address + size] = free - size;
+            freeBlocks.erase(address);
+            usedBlocks[block] = size;
+            return block;
+        }
+
+        Error(6);
+        return 0;
+    }
+
+    void DeAlloc(int block)
+    {
+        auto used = usedBlocks.find(block);
+        if (used == usedBlocks.end())
+            return;
+
+        auto it = freeBlocks.emplace(block, used->second).first;
+        usedBlocks.erase(used);
+
+        auto next = std::next(it);
+        if (next != freeBlocks.end() && it->first + it->second == next->first)
+        {
+            it->second += next->second;
+            freeBlocks.erase(next);
+        }
+
+        if (it != freeBlocks.begin())
+        {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second == it->first)
+            {
+                prev->second += it->second;
+                freeBlocks.erase(it);
+            }
+        }
+    }
+
+    void Error(int code)
+    {
+        std::cerr << "ERR" << code << "\n";
+        halted = true;
+    }
+
+    void DrawPixel(int x, int y)
+    {
+        if (x < 0 || x >= 512 || y < 0 || y >= 256)
+            return;
+
+        auto &word = ram[SCREEN + y * 32 + x / 16];
+        if (color)
+            word |= 1 << (x % 16);
+        else
+            word &= ~(1 << (x % 16));
+    }
+
+    void DrawLine(int x1, int y1, int x2, int y2)
+    {
+        int dx = std::abs(x2 - x1), dy = -std::abs(y2 - y1);
+        int sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1;
+        for (int error = dx + dy;;)
+        {
+            DrawPixel(x1, y1);
+            if (x1 == x2 && y1 == y2)
+                break;
+
+            if (2 * error >= dy)
+            {
+                error += dy;
+                x1 += sx;
+            }
+            if (2 * error <= dx)
+            {
+                error += dx;
+                y1 += sy;
+            }
+        }
+    }
+
+    // Strings of the builtin String class: maxLength, length, characters.
+    int16_t &StringLength(int16_t s)
+    {
+        return ram[Mask(s + 1)];
+    }
+
+    int16_t &StringChar(int16_t s, int j)
+    {
+        return ram[Mask(s + 2 + j)];
+    }
+
+    void Print(char c)
+    {
+        text += c;
+    }
+
+    int16_t CallBuiltin(Builtin builtin, const int16_t *args)
+    {
+        switch (builtin)
+        {
+        case Builtin::MATH_ABS:
+            return args[0] < 0 ? -args[0] : args[0];
+        case Builtin::MATH_MULTIPLY:
+            return static_cast<int16_t>(args[0] * args[1]);
+        case Builtin::MATH_DIVIDE:
+            if (args[1] == 0)
+            {
+                Error(3);
+                return 0;
+            }
+            return static_cast<int16_t>(args[0] / args[1]);
+        case Builtin::MATH_MIN:
+            return std::min(args[0], args[1]);
+        case Builtin::MATH_MAX:
+            return std::max(args[0], args[1]);
+        case Builtin::MATH_SQRT:
+        {
+            if (args[0] < 0)
+            {
+                Error(4);
+                return 0;
+            }
+            int16_t root = 0;
+            while ((root + 1) * (root + 1) <= args[0])
+                root++;
+            return root;
+        }
+        case Builtin::MEMORY_PEEK:
+            return ram[Mask(args[0])];
+        case Builtin::MEMORY_POKE:
+            ram[Mask(args[0])] = args[1];
+            return 0;
+        case Builtin::MEMORY_ALLOC:
+        case Builtin::ARRAY_NEW:
+            return Alloc(args[0]);
+        case Builtin::MEMORY_DEALLOC:
+        case Builtin::ARRAY_DISPOSE:
+        case Builtin::STRING_DISPOSE:
+            DeAlloc(args[0]);
+            return 0;
+        case Builtin::STRING_NEW:
+        {
+            auto s = Alloc(args[0] + 2);
+            ram[Mask(s)] = args[0];
+            StringLength(s) = 0;
+            return s;
+        }
+        case Builtin::STRING_LENGTH:
+            return StringLength(args[0]);
+        case Builtin::STRING_CHARAT:
+            return StringChar(args[0], args[1]);
+        case Builtin::STRING_SETCHARAT:
+            StringChar(args[0], args[1]) = args[2];
+            return 0;
+        case Builtin::STRING_APPENDCHAR:
+            if (StringLength(args[0]) < ram[Mask(args[0])])
+                StringChar(args[0], StringLength(args[0])++) = args[1];
+            return args[0];
+        case Builtin::STRING_ERASELASTCHAR:
+            if (StringLength(args[0]) > 0)
+                StringLength(args[0])--;
+            return 0;
+        case Builtin::STRING_INTVALUE:
+        {
+            int16_t value = 0;
+            bool negative = StringLength(args[0]) > 0 && StringChar(args[0], 0) == '-';
+            for (int j = negative; j < StringLength(args[0]); j++)
+            {
+                auto c = StringChar(args[0], j);
+                if (c < '0' || c > '9')
+                    break;
+                value = value * 10 + c - '0';
+            }
+            return negative ? -value : value;
+        }
+        case Builtin::STRING_SETINT:
+        {
+            auto digits = std::to_string(args[1]);
+            StringLength(args[0]) = 0;
+            for (auto c : digits)
+            {
+                if (StringLength(args[0]) < ram[Mask(args[0])])
+                    StringChar(args[0], StringLength(args[0])++) = c;
+            }
+            return 0;
+        }
+        case Builtin::STRING_NEWLINE:
+            return 128;
+        case Builtin::STRING_BACKSPACE:
+            return 129;
+        case Builtin::STRING_DOUBLEQUOTE:
+            return 34;
+        case Builtin::OUTPUT_PRINTCHAR:
+            Print(args[0]);
+            return 0;
+        case Builtin::OUTPUT_PRINTSTRING:
+            for (int j = 0; j < StringLength(args[0]); j++)
+                Print(StringChar(args[0], j));
+            return 0;
+        case Builtin::OUTPUT_PRINTINT:
+            text += std::to_string(args[0]);
+            return 0;
+        case Builtin::OUTPUT_PRINTLN:
+            Print('\n');
+            return 0;
+        case Builtin::OUTPUT_BACKSPACE:
+            if (!text.empty())
+                text.pop_back();
+            return 0;
+        case Builtin::SCREEN_CLEARSCREEN:
+            std::fill(ram.begin() + SCREEN, ram.begin() + KBD, 0);
+            return 0;
+        case Builtin::SCREEN_SETCOLOR:
+            color = args[0] != 0;
+            return 0;
+        case Builtin::SCREEN_DRAWPIXEL:
+            DrawPixel(args[0], args[1]);
+            return 0;
+        case Builtin::SCREEN_DRAWLINE:
+            DrawLine(args[0], args[1], args[2], args[3]);
+            return 0;
+        case Builtin::SCREEN_DRAWRECTANGLE:
+            for (int y = args[1]; y <= args[3]; y++)
+                DrawLine(args[0], y, args[2], y);
+            return 0;
+        case Builtin::SCREEN_DRAWCIRCLE:
+            for (int dy = -args[2]; dy <= args[2]; dy++)
+            {
+                int dx = 0;
+                while ((dx + 1) * (dx + 1) + dy * dy <= args[2] * args[2])
+                    dx++;
+                DrawLine(args[0] - dx, args[1] + dy, args[0] + dx, args[1] + dy);
+            }
+            return 0;
+        case Builtin::KEYBOARD_KEYPRESSED:
+        case Builtin::KEYBOARD_READCHAR:
+            return ram[KBD];
+        case Builtin::KEYBOARD_READLINE:
+            return CallBuiltin(Builtin::STRING_NEW, std::vector<int16_t>{0}.data());
+        case Builtin::KEYBOARD_READINT:
+            return 0;
+        case Builtin::SYS_HALT:
+            halted = true;
+            return 0;
+        case Builtin::SYS_ERROR:
+            Error(args[0]);
+            return 0;
+        case Builtin::SYS_WAIT:
+            // one frame of an animated program, the machine does not sleep
+            if (++frames >= maxFrames)
+                halted = true;
+            return 0;
+        default: // init functions
+            return 0;
+        }
+    }
+
+private:
+    std::vector<Instruction> program;
+    std::vector<Lowered> lowered;
+    std::vector<int> loweredIndex; // program index -> lowered index
+    bool fused = false;
+    std::map<std::string, int> functions;
+    std::set<std::string> loadedClasses;
+    std::map<std::string, int> labels;
+    std::map<std::string, int> statics;
+    std::vector<std::pair<int, std::string>> jumps;
+    std::vector<std::pair<int, std::string>> calls;
+
+    std::vector<int16_t> ram;
+    std::map<int, int> freeBlocks; // address -> size
+    std::map<int, int> usedBlocks;
+    std::string text;
+    bool color = true;
+    int entry = 0;
+    int pc = 0;
+    bool halted = false;
+    uint64_t frames = 0;
+    uint64_t maxFrames = UINT64_MAX;
+};
+
+// g++ --std=c++17 -O2 vm.cc -o vm
+int main(int argc, char *argv[])
+{
+    std::string input;
+    std::string engine = "fused";
+    uint64_t maxCycles = UINT64_MAX;
+    uint64_t maxFrames = UINT64_MAX;
+    std::vector<std::pair<int, int>> sets;
+    std::vector<int> prints;
+    std::string dumpFile;
+    std::string screenFile;
+    bool printText = false;
+    int repeat = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--engine" && i + 1 < argc)
+            engine = argv[++i];
+        else if (arg == "--cycles" && i + 1 < argc)
+            maxCycles = std::stoull(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc)
+            maxFrames = std::stoull(argv[++i]);
+        else if (arg == "--set" && i + 1 < argc)
+        {
+            std::string assignment(argv[++i]);
+            auto equal = assignment.find('=');
+            sets.emplace_back(std::stoi(assignment.substr(0, equal)), std::stoi(assignment.substr(equal + 1)));
+        }
+        else if (arg == "--print" && i + 1 < argc)
+            prints.push_back(std::stoi(argv[++i]));
+        else if (arg == "--dump" && i + 1 < argc)
+            dumpFile = argv[++i];
+        else if (arg == "--screen" && i + 1 < argc)
+            screenFile = argv[++i];
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--text")
+            printText = true;
+        else if (input.empty())
+            input = arg;
+        else
+        {
+            input.clear();
+            break;
+        }
+    }
+
+    if (input.empty())
+    {
+        std::cout << "Usage: /bin [--engine fused|plain] [--cycles N] [--frames N] [--set ADDR=VALUE]... [--print ADDR]... "
+                     "[--dump ram.txt] [--screen screen.pbm] [--text] [--repeat N] /path/to/input/file\n";
+        return 0;
+    }
+
+    // a directory is a whole program started by Sys.init, a file runs as is
+    std::filesystem::path input_filename(input);
+    std::vector<std::filesystem::path> paths;
+    bool isDirectory = std::filesystem::is_directory(input_filename);
+    if (isDirectory)
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(input_filename))
+        {
+            if (entry.path().extension() == ".vm")
+                paths.push_back(entry.path());
+        }
+        std::sort(paths.begin(), paths.end());
+    }
+    else
+        paths.push_back(input_filename);
+
+    VirtualMachine vm;
+    vm.SetMaxFrames(maxFrames);
+    try
+    {
+        vm.Load(paths);
+        if (isDirectory && (vm.HasFunction("Sys.init") || vm.HasFunction("Main.main")))
+            vm.Bootstrap();
+        vm.Link();
+        if (engine != "plain")
+            vm.Lower();
+    }
+    catch (const std::string &error)
+    {
+        std::cout << error << "\n";
+        return 1;
+    }
+
+    // every run starts from the same state, the last one is reported
+    uint64_t cycles = 0;
+    uint64_t frames = 0;
+    std::chrono::duration<double> elapsed{};
+    for (int run = 0; run < repeat; run++)
+    {
+        vm.Reset();
+        for (const auto &[address, value] : sets)
+            vm.Write(address, value);
+
+        auto start = std::chrono::steady_clock::now();
+        cycles += engine == "plain" ? vm.Run(maxCycles) : vm.RunFused(maxCycles);
+        elapsed += std::chrono::steady_clock::now() - start;
+        frames += vm.Frames();
+    }
+
+    std::cout << cycles << " commands, " << frames << " frames in " << elapsed.count() << " s, "
+              << cycles / elapsed.count() / 1e6 << " M commands/s\n";
+
+    for (auto address : prints)
+        std::cout << "RAM[" << address << "] = " << vm.Read(address) << "\n";
+
+    if (printText)
+        std::cout << vm.Text() << "\n";
+
+    if (!dumpFile.empty())
+    {
+        std::ofstream dump(dumpFile);
+        vm.DumpRAM(dump);
+    }
+
+    if (!screenFile.empty())
+    {
+        std::ofstream screen(screenFile);
+        vm.DumpScreen(screen);
+    }
+}
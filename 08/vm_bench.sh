@@ -0,0 +1,32 @@
+# g++ --std=c++17 -O2 vm.cc -o vm
+# needs ../11/compiler built as well
+# usage: sh vm_bench.sh [frames] [runs] [app dir]
+# Runs the app on the builtin OS up to [frames] calls of Sys.wait per run,
+# [runs] times over, then 12/MathTest and 12/MemoryTest [runs] x 10 times,
+# on both engines. Pong ends by itself after 224 frames without input.
+frames=${1:-1000}
+runs=${2:-1000}
+app=${3:-../11/Pong}
+
+tmp=$(mktemp -d)
+for test in MathTest MemoryTest; do
+    mkdir $tmp/$test
+    cp ../12/$test/Main.jack $tmp/$test
+    ../11/compiler $tmp/$test/ > /dev/null
+    mv $tmp/$test/Main.vm.g $tmp/$test/Main.vm
+done
+
+for engine in plain fused; do
+    echo "vm --engine $engine:"
+    echo "    $app: $(./vm --engine $engine --frames $frames --repeat $runs $app/)"
+    for test in MathTest MemoryTest; do
+        echo "    $test: $(./vm --engine $engine --repeat $((runs * 10)) $tmp/$test/)"
+    done
+done
+rm -r $tmp
+
+# the same game translated to Hack and emulated, for comparison
+if [ -x ../05/emulator ]; then
+    echo "hack emulator:"
+    ../05/emulator --cycles 1000000000 ../06/pong/Pong.e.hack
+fi
@@ -0,0 +1,49 @@
+# g++ --std=c++17 -O2 vm.cc -o vm
+# needs ../11/compiler built as well
+# Runs each VM test on both vm engines with the RAM setup of its .tst file
+# and compares the RAM words listed in its .cmp file.
+check() {
+    test=$1
+    shift
+    prints=$(head -1 $test.cmp | grep -o 'RAM\[[0-9]*' | sed 's/RAM\[/--print /')
+    for engine in plain fused; do
+        ./vm --engine $engine "$@" $prints | tail -n +2 > $test.vm.out
+        awk -F'|' 'NR == 1 { for (i = 2; i < NF; i++) { match($i, /[0-9]+/); a[i] = substr($i, RSTART, RLENGTH) } }
+            NR == 2 { for (i = 2; i < NF; i++) { v = $i; gsub(/ /, "", v); print "RAM[" a[i] "] = " v } }' $test.cmp | diff - $test.vm.out
+        rm $test.vm.out
+    done
+}
+
+check ../07/StackArithmetic/SimpleAdd/SimpleAdd --set 0=256 ../07/StackArithmetic/SimpleAdd/SimpleAdd.vm
+check ../07/StackArithmetic/StackTest/StackTest --set 0=256 ../07/StackArithmetic/StackTest/StackTest.vm
+check ../07/MemoryAccess/BasicTest/BasicTest --set 0=256 --set 1=300 --set 2=400 --set 3=3000 --set 4=3010 ../07/MemoryAccess/BasicTest/BasicTest.vm
+check ../07/MemoryAccess/PointerTest/PointerTest --set 0=256 ../07/MemoryAccess/PointerTest/PointerTest.vm
+check ../07/MemoryAccess/StaticTest/StaticTest --set 0=256 ../07/MemoryAccess/StaticTest/StaticTest.vm
+# 08
+check ProgramFlow/BasicLoop/BasicLoop --set 0=256 --set 1=300 --set 2=400 --set 400=3 ProgramFlow/BasicLoop/BasicLoop.vm
+check ProgramFlow/FibonacciSeries/FibonacciSeries --set 0=256 --set 1=300 --set 2=400 --set 400=6 --set 401=3000 ProgramFlow/FibonacciSeries/FibonacciSeries.vm
+check FunctionCalls/SimpleFunction/SimpleFunction --set 0=317 --set 1=317 --set 2=310 --set 3=3000 --set 4=4000 --set 310=1234 --set 311=37 --set 312=1000 --set 313=305 --set 314=300 --set 315=3010 --set 316=4010 FunctionCalls/SimpleFunction/SimpleFunction.vm
+check FunctionCalls/NestedCall/NestedCall --set 0=261 --set 1=261 --set 2=256 --set 3=-3 --set 4=-4 --set 5=-1 --set 6=-1 --set 256=1234 --set 257=-1 --set 258=-2 --set 259=-3 --set 260=-4 --set 261=-1 --set 262=-1 --set 263=-1 --set 264=-1 --set 265=-1 --set 266=-1 --set 267=-1 --set 268=-1 --set 269=-1 --set 270=-1 --set 271=-1 --set 272=-1 --set 273=-1 --set 274=-1 --set 275=-1 --set 276=-1 --set 277=-1 --set 278=-1 --set 279=-1 --set 280=-1 --set 281=-1 --set 282=-1 --set 283=-1 --set 284=-1 --set 285=-1 --set 286=-1 --set 287=-1 --set 288=-1 --set 289=-1 --set 290=-1 --set 291=-1 --set 292=-1 --set 293=-1 --set 294=-1 --set 295=-1 --set 296=-1 --set 297=-1 --set 298=-1 --set 299=-1 FunctionCalls/NestedCall/Sys.vm
+check FunctionCalls/FibonacciElement/FibonacciElement FunctionCalls/FibonacciElement/
+check FunctionCalls/StaticsTest/StaticsTest FunctionCalls/StaticsTest/
+# not is bitwise, so not; if-goto only falls through on -1, also when fused with the op before it
+tmp=$(mktemp -d)
+mkdir $tmp/NotBranch
+printf '%s\n' 'push constant 5' 'not' 'if-goto A' 'push constant 111' 'pop temp 0' 'label A' \
+    'push constant 1' 'push constant 1' 'and' 'not' 'if-goto B' 'push constant 222' 'pop temp 1' 'label B' \
+    'push constant 7' 'push constant 7' 'eq' 'not' 'if-goto C' 'push constant 333' 'pop temp 2' 'label C' \
+    'push constant 0' 'not' 'if-goto D' 'push constant 444' 'pop temp 3' 'label D' \
+    'label END' 'goto END' > $tmp/NotBranch/NotBranch.vm
+printf '%s\n' '|  RAM[5]  |  RAM[6]  |  RAM[7]  |  RAM[8]  |' '|       0  |       0  |     333  |       0  |' > $tmp/NotBranch/NotBranch.cmp
+check $tmp/NotBranch/NotBranch --set 0=256 $tmp/NotBranch/NotBranch.vm
+rm -r $tmp
+# 12, compiled with ../11/compiler and run on the builtin OS
+tmp=$(mktemp -d)
+for test in MathTest MemoryTest; do
+    mkdir $tmp/$test
+    cp ../12/$test/Main.jack ../12/$test/$test.cmp $tmp/$test
+    ../11/compiler $tmp/$test/ > /dev/null
+    mv $tmp/$test/Main.vm.g $tmp/$test/Main.vm
+    check $tmp/$test/$test $tmp/$test/
+done
+rm -r $tmp
@@ -0,0 +1,34 @@
+# usage: sh bench.sh [runs]
+# Tokenizer throughput over every .jack file in 09/, 11/ and 12/ concatenated
+# into one source, lexed [runs] times (200 by default), then compile time and
+# heap allocations for the 12/ OS classes, and compile time of a project of
+# COPIES (20 by default) copies of all those classes on 1 to 16 jobs.
+tmp=$(mktemp -d)
+g++ --std=c++17 -O2 -pthread -DCOUNT_ALLOCATIONS compiler.cc -o $tmp/compiler
+
+cat ../09/*/*.jack */*.jack ../12/*.jack ../12/*/*.jack > $tmp/All.jack
+echo "$(wc -c < $tmp/All.jack) bytes of Jack source"
+$tmp/compiler --tokenize --repeat ${1:-200} $tmp/All.jack
+
+mkdir $tmp/OS
+cp ../12/*.jack $tmp/OS/
+$tmp/compiler --stats $tmp/OS/
+
+mkdir $tmp/Many $tmp/Parallel
+for copy in $(seq ${COPIES:-20}); do
+    for file in ../09/*/*.jack */*.jack ../12/*.jack ../12/*/*.jack; do
+        cp $file $tmp/Many/$(echo ${file%.jack} | tr -d './')$copy.jack
+    done
+done
+for jobs in 1 2 4 8 16; do
+    $tmp/compiler --stats --jobs $jobs $tmp/Many/
+done
+
+# the output must not depend on the number of jobs
+mv $tmp/Many/*.vm.g $tmp/Parallel/
+$tmp/compiler --jobs 1 $tmp/Many/
+for file in $tmp/Many/*.vm.g; do
+    cmp -s $file $tmp/Parallel/$(basename $file) || echo "differs: $(basename $file)"
+done
+
+rm -r $tmp
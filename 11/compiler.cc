@@ -3,12 +3,26 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <cstdlib>
+#include <new>
+#include <charconv>
+#include <string_view>
 #include <fstream>
 #include <variant>
 #include <sstream>
 #include <iostream>
 #include <filesystem>
-#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 enum class TokenType
 {
@@ -44,8 +58,13 @@ enum class KeyWord
     THIS,
 };
 
-static std::set<char> symbols = {'[', ']', '{', '}', '(', ')', '.', ',', ';', '+', '-', '*', '/', '&', '|', '>', '<', '=', '~'};
-static std::map<std::string, KeyWord> keyWordMapping =
+struct KeyWordEntry
+{
+    std::string_view word;
+    KeyWord keyWord;
+};
+
+static constexpr KeyWordEntry keyWords[] =
     {
         {"class", KeyWord::CLASS},
         {"method", KeyWord::METHOD},
@@ -70,6 +89,86 @@ static std::map<std::string, KeyWord> keyWordMapping =
         {"this", KeyWord::THIS},
 };
 
+// every keyword has at least two characters, and the first two plus the
+// length put each of them in its own slot (checked below)
+static constexpr size_t KEYWORD_SLOTS = 32;
+
+static constexpr size_t KeyWordHash(std::string_view word)
+{
+    return (2 * static_cast<unsigned char>(word[0]) +
+            14 * static_cast<unsigned char>(word[1]) +
+            5 * word.size()) %
+           KEYWORD_SLOTS;
+}
+
+static constexpr std::array<KeyWordEntry, KEYWORD_SLOTS> MakeKeyWordTable()
+{
+    std::array<KeyWordEntry, KEYWORD_SLOTS> table{};
+    for (const auto &entry : keyWords)
+        table[KeyWordHash(entry.word)] = entry;
+    return table;
+}
+
+static constexpr auto keyWordTable = MakeKeyWordTable();
+
+static constexpr bool IsPerfectHash()
+{
+    for (const auto &entry : keyWords)
+    {
+        if (keyWordTable[KeyWordHash(entry.word)].word != entry.word)
+            return false;
+    }
+    return true;
+}
+
+static_assert(IsPerfectHash(), "two keywords share a slot");
+
+static const KeyWordEntry *FindKeyWord(std::string_view word)
+{
+    if (word.size() < 2)
+        return nullptr;
+
+    const auto &entry = keyWordTable[KeyWordHash(word)];
+    return entry.word == word ? &entry : nullptr;
+}
+
+enum class CharClass : uint8_t
+{
+    OTHER,
+    SPACE,
+    DIGIT,
+    LETTER,
+    SYMBOL,
+    QUOTE,
+    SLASH,
+};
+
+static constexpr std::array<CharClass, 256> MakeCharClasses()
+{
+    std::array<CharClass, 256> classes{};
+    for (char c : std::string_view(" \t\r\n\f\v"))
+        classes[static_cast<unsigned char>(c)] = CharClass::SPACE;
+    for (char c = '0'; c <= '9'; c++)
+        classes[static_cast<unsigned char>(c)] = CharClass::DIGIT;
+    for (char c = 'a'; c <= 'z'; c++)
+        classes[static_cast<unsigned char>(c)] = CharClass::LETTER;
+    for (char c = 'A'; c <= 'Z'; c++)
+        classes[static_cast<unsigned char>(c)] = CharClass::LETTER;
+    classes['_'] = CharClass::LETTER;
+    for (char c : std::string_view("[]{}().,;+-*&|<>=~"))
+        classes[static_cast<unsigned char>(c)] = CharClass::SYMBOL;
+    classes['"'] = CharClass::QUOTE;
+    classes['/'] = CharClass::SLASH;
+    return classes;
+}
+
+static constexpr auto charClasses = MakeCharClasses();
+
+static CharClass ClassOf(char c)
+{
+    return charClasses[static_cast<unsigned char>(c)];
+}
+
 static std::string KeyWordToString(KeyWord key)
 {
     switch (key)
@@ -139,84 +238,67 @@ static std::string CharToPrintString(char c)
     }
 }
 
-class Tokenizer
+// a read-only view of a whole source file, mapped instead of read
+class MappedFile
 {
 public:
-    Tokenizer(const std::string &filename)
-        : index(-1)
+    MappedFile(const std::string &filename)
     {
-        std::ifstream inputstream{filename};
-        std::string line;
-        bool blockcomment = false;
-        while (std::getline(inputstream, line))
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw "cannot open source file";
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
         {
-            boost::trim(line);
-            if (blockcomment)
-                line = HandleBlockComment(line, blockcomment);
-            else
+            size = info.st_size;
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED)
             {
-                int doubleslash = line.find("//");
-                int slashasterisk = line.find("/*");
-                int doccomment = line.find("/**");
-
-                // suppose we don't mix them in source code
-                bool haslinecoment = doubleslash >= 0;
-                bool hasblockcomment = slashasterisk >= 0;
-                bool hasdoccomment = doccomment >= 0;
-                if (haslinecoment)
-                    line = line.substr(0, doubleslash);
-                else if (hasblockcomment || hasdoccomment)
-                {
-                    blockcomment = true;
-                    line = HandleBlockComment(line, blockcomment);
-                }
+                close(fd);
+                throw "cannot map source file";
             }
+            data = static_cast<const char *>(mapped);
+        }
+        close(fd);
+    }
 
-            boost::trim(line);
-            if (line.empty())
-                continue;
-
-            auto words = Split(line);
-            for (auto &&word : words)
-            {
-                boost::trim(word);
-                if (word.empty())
-                    continue;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
 
-                // KEYWORD
-                auto pair = keyWordMapping.find(word);
-                if (pair != keyWordMapping.end())
-                {
-                    tokens.push_back(std::make_pair(TokenType::KEYWORD, word));
-                    continue;
-                }
+    ~MappedFile()
+    {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+    }
 
-                // SYMBOL
-                if (word.length() == 1 &&
-                    symbols.find(word[0]) != symbols.end())
-                {
-                    tokens.push_back(std::make_pair(TokenType::SYMBOL, word));
-                    continue;
-                }
+    std::string_view Text() const
+    {
+        return std::string_view(data, size);
+    }
 
-                // INT_CONST
-                if (std::isdigit(word[0]))
-                {
-                    tokens.push_back(std::make_pair(TokenType::INT_CONST, word));
-                    continue;
-                }
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+};
 
-                // STRING_CONST
-                if (word[0] == '"')
-                {
-                    tokens.push_back(std::make_pair(TokenType::STRING_CONST, word.substr(1, word.length() - 2)));
-                    continue;
-                }
+// text points into the mapped source, offset is where the token starts in it;
+// keyWord is only meaningful for KEYWORD tokens
+struct Token
+{
+    TokenType type;
+    KeyWord keyWord;
+    int offset;
+    std::string_view text;
+};
 
-                // IDENTIFIER
-                tokens.push_back(std::make_pair(TokenType::IDENTIFIER, word));
-            }
-        }
+class Tokenizer
+{
+public:
+    Tokenizer(const std::string &filename)
+        : source(filename), index(-1)
+    {
+        Lex(source.Text());
     }
 
     bool HasMoreTokens() const
@@ -234,83 +316,188 @@ public:
         index--;
     }
 
+    size_t TokenCount() const
+    {
+        return tokens.size();
+    }
+
     TokenType GetTokenType() const
     {
-        return tokens[index].first;
+        return tokens[index].type;
     }
 
     KeyWord GetKeyWord() const
     {
-        return keyWordMapping[tokens[index].second];
+        return tokens[index].keyWord;
     }
 
     char GetSymbol() const
     {
-        return tokens[index].second[0];
+        return tokens[index].text[0];
     }
 
-    const std::string &GetIdentifier() const
+    std::string_view GetIdentifier() const
     {
-        return tokens[index].second;
+        return tokens[index].text;
     }
 
     int GetIntVal() const
     {
-        return std::stoi(tokens[index].second);
+        int value = 0;
+        auto text = tokens[index].text;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
     }
 
-    const std::string &GetStringVal() const
+    std::string_view GetStringVal() const
     {
-        return tokens[index].second;
+        return tokens[index].text;
     }
 
 private:
-    std::string HandleBlockComment(const std::string &line, bool &begincomment)
-    {
-        int index = line.find("*/");
-        if (index >= 0)
-        {
-            begincomment = false;
-            return line.substr(index + 2);
-        }
-        else
-            return "";
-    }
+    enum class State
+    {
+        START,
+        WORD,
+        NUMBER,
+        STRING,
+        SLASH,
+        LINE_COMMENT,
+        BLOCK_COMMENT,
+        BLOCK_STAR,
+    };
 
-    std::vector<std::string> Split(const std::string &line)
+    // a single pass over the source; a state that ends a token on c falls
+    // through to START without consuming c, so every character is read once
+    void Lex(std::string_view text)
     {
-        int previous = 0;
-        std::vector<std::string> words;
-        for (int i = 0; i < line.size(); i++)
+        tokens.reserve(text.size() / 4);
+
+        auto state = State::START;
+        size_t begin = 0;
+        size_t i = 0;
+        while (i <= text.size())
         {
-            if (line[i] == '"')
+            // a newline past the end flushes the last word and ends line comments
+            char c = i < text.size() ? text[i] : '\n';
+            switch (state)
             {
-                words.push_back(line.substr(previous, i - previous));
+            case State::START:
+                switch (ClassOf(c))
+                {
+                case CharClass::SPACE:
+                    break;
+                case CharClass::DIGIT:
+                    begin = i;
+                    state = State::NUMBER;
+                    break;
+                case CharClass::LETTER:
+                    begin = i;
+                    state = State::WORD;
+                    break;
+                case CharClass::QUOTE:
+                    begin = i + 1;
+                    state = State::STRING;
+                    break;
+                case CharClass::SLASH:
+                    begin = i;
+                    state = State::SLASH;
+                    break;
+                case CharClass::SYMBOL:
+                    Emit(TokenType::SYMBOL, text, i, i + 1);
+                    break;
+                case CharClass::OTHER:
+                    throw "unexpected character in source";
+                }
+                i++;
+                break;
 
-                int begin = i;
+            case State::WORD:
+                if (ClassOf(c) == CharClass::LETTER || ClassOf(c) == CharClass::DIGIT)
+                {
+                    i++;
+                    break;
+                }
+                if (auto entry = FindKeyWord(text.substr(begin, i - begin)))
+                    Emit(TokenType::KEYWORD, text, begin, i, entry->keyWord);
+                else
+                    Emit(TokenType::IDENTIFIER, text, begin, i);
+                state = State::START;
+                break;
+
+            case State::NUMBER:
+                if (ClassOf(c) == CharClass::DIGIT)
+                {
+                    i++;
+                    break;
+                }
+                Emit(TokenType::INT_CONST, text, begin, i);
+                state = State::START;
+                break;
+
+            case State::STRING:
+                if (c == '"')
+                {
+                    Emit(TokenType::STRING_CONST, text, begin, i);
+                    state = State::START;
+                }
+                else if (c == '\n')
+                    throw "unterminated string constant";
                 i++;
-                while (line[i] != '"')
+                break;
+
+            case State::SLASH:
+                if (c == '/')
+                {
+                    state = State::LINE_COMMENT;
                     i++;
+                }
+                else if (c == '*')
+                {
+                    state = State::BLOCK_COMMENT;
+                    i++;
+                }
+                else
+                {
+                    Emit(TokenType::SYMBOL, text, begin, begin + 1);
+                    state = State::START;
+                }
+                break;
 
-                int end = i + 1;
-                words.push_back(line.substr(begin, end - begin));
-                previous = i + 1;
-            }
+            case State::LINE_COMMENT:
+                if (c == '\n')
+                    state = State::START;
+                i++;
+                break;
 
-            if (line[i] == ' ' || symbols.find(line[i]) != symbols.end())
-            {
-                words.push_back(line.substr(previous, i - previous));
+            case State::BLOCK_COMMENT:
+                if (c == '*')
+                    state = State::BLOCK_STAR;
+                i++;
+                break;
 
-                words.push_back(line.substr(i, 1));
-                previous = i + 1;
+            case State::BLOCK_STAR:
+                if (c == '/')
+                    state = State::START;
+                else if (c != '*')
+                    state = State::BLOCK_COMMENT;
+                i++;
+                break;
             }
         }
 
-        return words;
+        if (state == State::BLOCK_COMMENT || state == State::BLOCK_STAR)
+            throw "unterminated block comment";
+    }
+
+    void Emit(TokenType type, std::string_view text, size_t begin, size_t end, KeyWord keyWord = KeyWord::CLASS)
+    {
+        tokens.push_back(Token{type, keyWord, static_cast<int>(begin), text.substr(begin, end - begin)});
     }
 
 private:
-    std::vector<std::pair<TokenType, std::string>> tokens;
+    MappedFile source;
+    std::vector<Token> tokens;
     int index;
 };
 
@@ -364,10 +551,38 @@ enum class Command
     NOT,
 };
 
+// Append-only text buffer for VMWriter, written out in one go with Flush.
+class OutputBuffer
+{
+public:
+    OutputBuffer &operator<<(std::string_view text)
+    {
+        buffer.append(text);
+        return *this;
+    }
+
+    OutputBuffer &operator<<(int value)
+    {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+
+    void Flush(std::ostream &output)
+    {
+        output.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+private:
+    std::string buffer;
+};
+
 class VMWriter
 {
 public:
-    VMWriter(std::ostream &output)
+    VMWriter(OutputBuffer &output)
         : o(output)
     {
     }
@@ -419,27 +634,27 @@ public:
         }
     }
 
-    void WriteLabel(const std::string &label) const
+    void WriteLabel(std::string_view label) const
     {
         o << "label " << label << "\n";
     }
 
-    void WriteGoto(const std::string &label) const
+    void WriteGoto(std::string_view label) const
     {
         o << "goto " << label << "\n";
     }
 
-    void WriteIf(const std::string &label) const
+    void WriteIf(std::string_view label) const
     {
         o << "if-goto " << label << "\n";
     }
 
-    void WriteCall(const std::string &name, int nArgs) const
+    void WriteCall(std::string_view name, int nArgs) const
     {
         o << "call " << name << " " << nArgs << "\n";
     }
 
-    void WriteFunction(const std::string &name, int nArgs) const
+    void WriteFunction(std::string_view name, int nArgs) const
     {
         o << "function " << name << " " << nArgs << "\n";
     }
@@ -450,9 +665,165 @@ public:
     }
 
 private:
-    std::ostream &o;
+    OutputBuffer &o;
+};
+
+// Bump allocator for the AST of one class. Nodes, lists and identifiers
+// live in large blocks that are all released together with the arena, so
+// nothing allocated here ever has its destructor run.
+class Arena
+{
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    template <typename T, typename... Args>
+    T *New(Args &&...args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T *NewArray(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    std::string_view Copy(std::string_view text)
+    {
+        if (text.empty())
+            return {};
+
+        auto copy = NewArray<char>(text.size());
+        std::copy(text.begin(), text.end(), copy);
+        return std::string_view(copy, text.size());
+    }
+
+    // one copy per distinct identifier, found again through an open-addressed table
+    std::string_view Intern(std::string_view text)
+    {
+        if (2 * (internedCount + 1) > interned.size())
+            Rehash(interned.empty() ? 256 : 2 * interned.size());
+
+        size_t mask = interned.size() - 1;
+        for (size_t i = Hash(text) & mask;; i = (i + 1) & mask)
+        {
+            if (interned[i].data() == nullptr)
+            {
+                interned[i] = Copy(text);
+                internedCount++;
+                return interned[i];
+            }
+            if (interned[i] == text)
+                return interned[i];
+        }
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    void *Allocate(size_t size, size_t align)
+    {
+        auto address = (reinterpret_cast<uintptr_t>(next) + align - 1) & ~(uintptr_t)(align - 1);
+        if (blocks.empty() || address + size > reinterpret_cast<uintptr_t>(end))
+        {
+            auto bytes = std::max(size + align, BLOCK_SIZE);
+            blocks.emplace_back(new char[bytes]);
+            next = blocks.back().get();
+            end = next + bytes;
+            address = (reinterpret_cast<uintptr_t>(next) + align - 1) & ~(uintptr_t)(align - 1);
+        }
+
+        next = reinterpret_cast<char *>(address + size);
+        return reinterpret_cast<void *>(address);
+    }
+
+    static size_t Hash(std::string_view text)
+    {
+        size_t hash = 14695981039346656037ull;
+        for (char c : text)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        return hash;
+    }
+
+    void Rehash(size_t size)
+    {
+        std::vector<std::string_view> old(size);
+        old.swap(interned);
+        for (auto text : old)
+        {
+            if (text.data() == nullptr)
+                continue;
+
+            size_t i = Hash(text) & (size - 1);
+            while (interned[i].data() != nullptr)
+                i = (i + 1) & (size - 1);
+            interned[i] = text;
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *next = nullptr;
+    char *end = nullptr;
+    std::vector<std::string_view> interned;
+    size_t internedCount = 0;
 };
 
+// a growable array inside an arena; storage it outgrows is simply left there
+template <typename T>
+class ArenaList
+{
+public:
+    void Add(Arena *arena, T item)
+    {
+        if (count == capacity)
+        {
+            capacity = capacity == 0 ? 4 : 2 * capacity;
+            auto grown = arena->NewArray<T>(capacity);
+            std::copy(items, items + count, grown);
+            items = grown;
+        }
+        items[count++] = item;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    T operator[](size_t i) const
+    {
+        return items[i];
+    }
+
+    const T *begin() const
+    {
+        return items;
+    }
+
+    const T *end() const
+    {
+        return items + count;
+    }
+
+private:
+    T *items = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+};
+
+static std::string QualifiedName(std::string_view className, std::string_view name)
+{
+    std::string qualified;
+    qualified.reserve(className.size() + 1 + name.size());
+    qualified.append(className).append(".").append(name);
+    return qualified;
+}
+
 static void ConsumeChar(Tokenizer *tokenizer, char expectedChar)
 {
     tokenizer->Advance();
@@ -475,9 +846,9 @@ private:
 
 public:
     // int|char|boolean|className
-    static std::unique_ptr<JackType> Compile(Tokenizer *tokenizer)
+    static JackType *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto type = std::make_unique<JackType>();
+        auto type = arena->New<JackType>();
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::KEYWORD)
         {
@@ -504,7 +875,7 @@ public:
         else if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
         {
             type->type = InternalType::CLASS;
-            type->className = tokenizer->GetIdentifier();
+            type->className = arena->Intern(tokenizer->GetIdentifier());
         }
         else
         {
@@ -514,7 +885,7 @@ public:
         return type;
     }
 
-    std::string GetName() const
+    std::string_view GetName() const
     {
         if (type == InternalType::CLASS)
             return className;
@@ -524,7 +895,7 @@ public:
 
 private:
     enum InternalType type;
-    std::string className; // if type is class
+    std::string_view className; // if type is class
 };
 
 enum class VarKind
@@ -576,7 +947,7 @@ public:
         indexes[0] = indexes[1] = indexes[2] = indexes[3] = 0;
     }
 
-    void Define(const std::string &name, JackType type, VarKind kind)
+    void Define(std::string_view name, JackType type, VarKind kind)
     {
         if (table.find(name) == table.end())
         {
@@ -590,7 +961,7 @@ public:
         return indexes[(int)kind];
     }
 
-    VarKind KindOf(const std::string &name) const
+    VarKind KindOf(std::string_view name) const
     {
         auto pair = table.find(name);
         if (pair != table.end())
@@ -599,56 +970,74 @@ public:
         return VarKind::NONE;
     }
 
-    JackType TypdOf(const std::string &name) const
+    JackType TypdOf(std::string_view name) const
     {
         return table.find(name)->second.type;
     }
 
-    int IndexOf(const std::string &name) const
+    int IndexOf(std::string_view name) const
     {
         return table.find(name)->second.index;
     }
 
 private:
     int indexes[4];
-    std::map<const std::string, Property> table;
+    std::map<std::string_view, Property> table; // keys live in the class arena
+};
+
+enum class SubroutineType
+{
+    CONSTRUCTOR,
+    FUNCTION,
+    METHOD,
 };
 
-// TODO put them into context
-static SymbolTable ClassVariables;
-static SymbolTable LocalVariables;
+// everything code generation of one class mutates, so classes can be
+// compiled side by side
+class Context
+{
+public:
+    std::string_view className;
+    int nFields;
+    SubroutineType subroutineType;
+
+    SymbolTable classVariables;
+    SymbolTable localVariables;
+    int whileLabel = -1;
+    int ifLabel = -1;
+};
 
-static void GetPropertyByName(const std::string &name, VarKind &kind, int &index, JackType *type = nullptr)
+static void GetPropertyByName(const Context &context, std::string_view name, VarKind &kind, int &index, JackType *type = nullptr)
 {
-    kind = LocalVariables.KindOf(name);
+    kind = context.localVariables.KindOf(name);
     if (kind == VarKind::NONE)
     {
-        kind = ClassVariables.KindOf(name);
+        kind = context.classVariables.KindOf(name);
         if (kind != VarKind::NONE)
         {
-            index = ClassVariables.IndexOf(name);
+            index = context.classVariables.IndexOf(name);
             if (type)
-                *type = ClassVariables.TypdOf(name);
+                *type = context.classVariables.TypdOf(name);
         }
 
         return;
     }
 
-    index = LocalVariables.IndexOf(name);
+    index = context.localVariables.IndexOf(name);
     if (type)
-        *type = LocalVariables.TypdOf(name);
+        *type = context.localVariables.TypdOf(name);
 }
 
 class ClassVarDec
 {
 public:
     // (static | field) type varName(, varName)* ';'
-    static std::unique_ptr<ClassVarDec> Compile(Tokenizer *tokenizer)
+    static ClassVarDec *Compile(Tokenizer *tokenizer, Arena *arena)
     {
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::KEYWORD)
         {
-            auto dec = std::make_unique<ClassVarDec>();
+            auto dec = arena->New<ClassVarDec>();
             auto keyword = tokenizer->GetKeyWord();
             if (keyword == KeyWord::STATIC)
                 dec->isStatic = true;
@@ -657,11 +1046,11 @@ public:
             else
                 goto EXIT;
 
-            dec->type = JackType::Compile(tokenizer);
+            dec->type = JackType::Compile(tokenizer, arena);
 
             tokenizer->Advance();
             if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-                dec->varNames.push_back(tokenizer->GetIdentifier());
+                dec->varNames.Add(arena, arena->Intern(tokenizer->GetIdentifier()));
             else
                 throw "expect an identifier for var name";
 
@@ -677,7 +1066,7 @@ public:
                     {
                         tokenizer->Advance();
                         if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-                            dec->varNames.push_back(tokenizer->GetIdentifier());
+                            dec->varNames.Add(arena, arena->Intern(tokenizer->GetIdentifier()));
                         else
                             throw "expect an identifier for var name";
                     }
@@ -696,12 +1085,12 @@ public:
         return nullptr;
     }
 
-    void FillVarTable() const
+    void FillVarTable(Context &context) const
     {
         VarKind kind = isStatic ? VarKind::STATIC : VarKind::FIELD;
 
         for (auto &&name : varNames)
-            ClassVariables.Define(name, *(type.get()), kind);
+            context.classVariables.Define(name, *type, kind);
     }
 
     int FieldCount() const
@@ -714,28 +1103,28 @@ public:
 
 private:
     bool isStatic; // false means field
-    std::unique_ptr<JackType> type;
-    std::vector<std::string> varNames;
+    JackType *type = nullptr;
+    ArenaList<std::string_view> varNames;
 };
 
 class ParameterList
 {
 public:
     // ((type varName) (, type varName)*)?
-    static std::unique_ptr<ParameterList> Compile(Tokenizer *tokenizer)
+    static ParameterList *Compile(Tokenizer *tokenizer, Arena *arena)
     {
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::KEYWORD ||
             tokenizer->GetTokenType() == TokenType::IDENTIFIER)
         {
-            auto list = std::make_unique<ParameterList>();
+            auto list = arena->New<ParameterList>();
             tokenizer->GoBack();
-            auto type = JackType::Compile(tokenizer);
-            list->types.push_back(std::move(type));
+            auto type = JackType::Compile(tokenizer, arena);
+            list->types.Add(arena, type);
 
             tokenizer->Advance();
             if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-                list->names.push_back(tokenizer->GetIdentifier());
+                list->names.Add(arena, arena->Intern(tokenizer->GetIdentifier()));
             else
                 throw "expect an identifier for var name";
 
@@ -745,12 +1134,12 @@ public:
                 if (tokenizer->GetTokenType() == TokenType::SYMBOL &&
                     tokenizer->GetSymbol() == ',')
                 {
-                    auto type = JackType::Compile(tokenizer);
-                    list->types.push_back(std::move(type));
+                    auto type = JackType::Compile(tokenizer, arena);
+                    list->types.Add(arena, type);
 
                     tokenizer->Advance();
                     if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-                        list->names.push_back(tokenizer->GetIdentifier());
+                        list->names.Add(arena, arena->Intern(tokenizer->GetIdentifier()));
                     else
                         throw "expect an identifier for var name";
                 }
@@ -768,30 +1157,15 @@ public:
         return nullptr;
     }
 
-    void FillVarTable() const
+    void FillVarTable(Context &context) const
     {
         for (size_t i = 0; i < types.size(); i++)
-            LocalVariables.Define(names[i], *(types[i].get()), VarKind::ARG);
+            context.localVariables.Define(names[i], *types[i], VarKind::ARG);
     }
 
 private:
-    std::vector<std::unique_ptr<JackType>> types;
-    std::vector<std::string> names;
-};
-
-enum class SubroutineType
-{
-    CONSTRUCTOR,
-    FUNCTION,
-    METHOD,
-};
-
-class Context
-{
-public:
-    std::string className;
-    int nFields;
-    SubroutineType subroutineType;
+    ArenaList<JackType *> types;
+    ArenaList<std::string_view> names;
 };
 
 class Term;
@@ -799,15 +1173,15 @@ class Term;
 class Expression
 {
 public:
-    static std::unique_ptr<Expression> Compile(Tokenizer *tokenizer);
+    static Expression *Compile(Tokenizer *tokenizer, Arena *arena);
 
     void GenVMCode(const VMWriter &writer, Context &context);
 
 private:
-    std::unique_ptr<Term> term;
+    Term *term = nullptr;
 
-    std::vector<char> ops;
-    std::vector<std::unique_ptr<Term>> terms;
+    ArenaList<char> ops;
+    ArenaList<Term *> terms;
 };
 
 class ExpressionList
@@ -816,17 +1190,17 @@ public:
     // only used by SubroutineCall, which will check if ExpressionList is empty
     // so this contains at least one expression
     // (expression (,expression)*)?
-    static std::unique_ptr<ExpressionList> Compile(Tokenizer *tokenizer)
+    static ExpressionList *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto list = std::make_unique<ExpressionList>();
+        auto list = arena->New<ExpressionList>();
 
-        list->expression = Expression::Compile(tokenizer);
+        list->expression = Expression::Compile(tokenizer, arena);
         while (true)
         {
             tokenizer->Advance();
             if (tokenizer->GetTokenType() == TokenType::SYMBOL &&
                 tokenizer->GetSymbol() == ',')
-                list->expressions.push_back(Expression::Compile(tokenizer));
+                list->expressions.Add(arena, Expression::Compile(tokenizer, arena));
             else
             {
                 tokenizer->GoBack();
@@ -850,21 +1224,21 @@ public:
     }
 
 private:
-    std::unique_ptr<Expression> expression;
-    std::vector<std::unique_ptr<Expression>> expressions;
+    Expression *expression = nullptr;
+    ArenaList<Expression *> expressions;
 };
 
 class SubroutineCall
 {
 public:
     // subroutineName( expressionList ) | (className|varName).subroutineName( expressionList )
-    static std::unique_ptr<SubroutineCall> Compile(Tokenizer *tokenizer)
+    static SubroutineCall *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto call = std::make_unique<SubroutineCall>();
+        auto call = arena->New<SubroutineCall>();
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
         {
-            auto firstId = tokenizer->GetIdentifier();
+            auto firstId = arena->Intern(tokenizer->GetIdentifier());
 
             tokenizer->Advance();
             if (tokenizer->GetTokenType() == TokenType::SYMBOL)
@@ -875,19 +1249,19 @@ public:
                     call->subroutineName = firstId;
                     call->identifierName = "";
 
-                    HandleExpressionList(tokenizer, call.get());
+                    HandleExpressionList(tokenizer, arena, call);
                 }
                 else if (symbol == '.')
                 {
                     tokenizer->Advance();
                     if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
                     {
-                        call->subroutineName = tokenizer->GetIdentifier();
+                        call->subroutineName = arena->Intern(tokenizer->GetIdentifier());
                         call->identifierName = firstId;
 
                         ConsumeChar(tokenizer, '(');
 
-                        HandleExpressionList(tokenizer, call.get());
+                        HandleExpressionList(tokenizer, arena, call);
                     }
                     else
                         throw "expect an identifier for subroutine name";
@@ -907,33 +1281,34 @@ public:
     void GenVMCode(const VMWriter &writer, Context &context)
     {
         int initNArgs = 0;
-        if (identifierName == "")
+        auto className = identifierName;
+        if (identifierName.empty())
         {
             // call method, push this
             writer.WritePush(Segment::POINTER, 0);
             initNArgs = 1;
-            identifierName = context.className;
+            className = context.className;
         }
         else
         {
             VarKind kind = VarKind::NONE;
             int index;
             JackType type;
-            GetPropertyByName(identifierName, kind, index, &type);
+            GetPropertyByName(context, identifierName, kind, index, &type);
 
             switch (kind)
             {
             case VarKind::FIELD:
                 writer.WritePush(Segment::THIS, index);
                 initNArgs = 1;
-                identifierName = type.GetName();
+                className = type.GetName();
                 break;
             case VarKind::STATIC:
                 break;
             case VarKind::VAR:
                 writer.WritePush(Segment::LOCAL, index);
                 initNArgs = 1;
-                identifierName = type.GetName();
+                className = type.GetName();
                 break;
             case VarKind::ARG:
                 break;
@@ -947,12 +1322,11 @@ public:
         if (expressionList)
             expressionList->GenVMCode(writer, context);
 
-        auto name = identifierName + "." + subroutineName;
-        writer.WriteCall(name, expressionList ? expressionList->Count() + initNArgs : initNArgs);
+        writer.WriteCall(QualifiedName(className, subroutineName), expressionList ? expressionList->Count() + initNArgs : initNArgs);
     }
 
 private:
-    static void HandleExpressionList(Tokenizer *tokenizer, SubroutineCall *call)
+    static void HandleExpressionList(Tokenizer *tokenizer, Arena *arena, SubroutineCall *call)
     {
         tokenizer->Advance();
         auto nextType = tokenizer->GetTokenType();
@@ -963,16 +1337,16 @@ private:
         {
             tokenizer->GoBack();
 
-            call->expressionList = ExpressionList::Compile(tokenizer);
+            call->expressionList = ExpressionList::Compile(tokenizer, arena);
 
             ConsumeChar(tokenizer, ')');
         }
     }
 
 private:
-    std::string subroutineName;
-    std::string identifierName;
-    std::unique_ptr<ExpressionList> expressionList;
+    std::string_view subroutineName;
+    std::string_view identifierName;
+    ExpressionList *expressionList = nullptr;
 };
 
 static std::set<char> UnaryOps{'-', '~'};
@@ -989,11 +1363,11 @@ enum class TermType
     SUBROUTINECALL,
 };
 
-static void PushVar(const VMWriter &writer, const Context &context, const std::string &varName)
+static void PushVar(const VMWriter &writer, const Context &context, std::string_view varName)
 {
     VarKind kind = VarKind::NONE;
     int index = 0;
-    GetPropertyByName(varName, kind, index);
+    GetPropertyByName(context, varName, kind, index);
 
     if (context.subroutineType == SubroutineType::METHOD &&
         kind == VarKind::ARG)
@@ -1007,9 +1381,9 @@ class Term
 public:
     // integerConstant | stringConstant | keywordConst | varName |
     // varName'['expression']' | '('expression')' | (unaryOp term) | subroutineCall
-    static std::unique_ptr<Term> Compile(Tokenizer *tokenizer)
+    static Term *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto term = std::make_unique<Term>();
+        auto term = arena->New<Term>();
         tokenizer->Advance();
         switch (tokenizer->GetTokenType())
         {
@@ -1022,7 +1396,7 @@ public:
         case TokenType::STRING_CONST:
         {
             term->termType = TermType::STRING_CONST;
-            term->stringConst = tokenizer->GetStringVal();
+            term->stringConst = arena->Copy(tokenizer->GetStringVal());
             break;
         }
         case TokenType::KEYWORD:
@@ -1046,7 +1420,7 @@ public:
         case TokenType::IDENTIFIER:
         {
             term->termType = TermType::VARNAME;
-            term->varName = tokenizer->GetIdentifier();
+            term->varName = arena->Intern(tokenizer->GetIdentifier());
 
             tokenizer->Advance();
             if (tokenizer->GetTokenType() == TokenType::SYMBOL)
@@ -1055,7 +1429,7 @@ public:
                 if (symbol == '[')
                 {
                     term->termType = TermType::VAR_EXPRESSION;
-                    term->varExpr = Expression::Compile(tokenizer);
+                    term->varExpr = Expression::Compile(tokenizer, arena);
 
                     ConsumeChar(tokenizer, ']');
                 }
@@ -1065,7 +1439,7 @@ public:
 
                     tokenizer->GoBack(); // .
                     tokenizer->GoBack(); // identifier
-                    term->subroutineCall = SubroutineCall::Compile(tokenizer);
+                    term->subroutineCall = SubroutineCall::Compile(tokenizer, arena);
                 }
                 else
                     tokenizer->GoBack();
@@ -1079,14 +1453,14 @@ public:
             if (symbol == '(')
             {
                 term->termType = TermType::WHOLE_EXPRESSION;
-                term->wholeExpr = Expression::Compile(tokenizer);
+                term->wholeExpr = Expression::Compile(tokenizer, arena);
                 ConsumeChar(tokenizer, ')');
             }
             else if (UnaryOps.find(symbol) != UnaryOps.end())
             {
                 term->termType = TermType::UNARYOP;
                 term->unaryChar = symbol;
-                term->unaryTerm = Term::Compile(tokenizer);
+                term->unaryTerm = Term::Compile(tokenizer, arena);
             }
             else
                 throw "expect a symbol (|-|~";
@@ -1187,15 +1561,15 @@ public:
 
 private:
     TermType termType;
-    std::string varName;
-    std::unique_ptr<Expression> varExpr;
-    std::unique_ptr<Expression> wholeExpr;
+    std::string_view varName;
+    Expression *varExpr = nullptr;
+    Expression *wholeExpr = nullptr;
     char unaryChar;
-    std::unique_ptr<Term> unaryTerm;
+    Term *unaryTerm = nullptr;
     KeyWord keywordConst;
-    std::unique_ptr<SubroutineCall> subroutineCall;
+    SubroutineCall *subroutineCall = nullptr;
     int intConst;
-    std::string stringConst;
+    std::string_view stringConst;
 };
 
 static std::set<char> Ops{'+', '-', '*', '/', '&', '|', '>', '<', '='};
@@ -1238,11 +1612,11 @@ static void GenOpVMCode(char op, const VMWriter &writer)
 }
 
 // term (op term)*
-std::unique_ptr<Expression> Expression::Compile(Tokenizer *tokenizer)
+Expression *Expression::Compile(Tokenizer *tokenizer, Arena *arena)
 {
-    auto expr = std::make_unique<Expression>();
+    auto expr = arena->New<Expression>();
 
-    expr->term = Term::Compile(tokenizer);
+    expr->term = Term::Compile(tokenizer, arena);
     while (true)
     {
         tokenizer->Advance();
@@ -1251,8 +1625,8 @@ std::unique_ptr<Expression> Expression::Compile(Tokenizer *tokenizer)
             auto symbol = tokenizer->GetSymbol();
             if (Ops.find(symbol) != Ops.end())
             {
-                expr->ops.push_back(symbol);
-                expr->terms.push_back(Term::Compile(tokenizer));
+                expr->ops.Add(arena, symbol);
+                expr->terms.Add(arena, Term::Compile(tokenizer, arena));
             }
             else
                 goto BREAK;
@@ -1279,20 +1653,16 @@ void Expression::GenVMCode(const VMWriter &writer, Context &context)
     }
 }
 
-// TODO put them into context
-static int whilelabel = -1;
-static int iflabel = -1;
-
-static void ResetLabelIndex()
+static void ResetLabelIndex(Context &context)
 {
-    whilelabel = -1;
-    iflabel = -1;
+    context.whileLabel = -1;
+    context.ifLabel = -1;
 }
 
-static int GetWhileLabelIndex()
+static int GetWhileLabelIndex(Context &context)
 {
-    whilelabel++;
-    return whilelabel;
+    context.whileLabel++;
+    return context.whileLabel;
 }
 
 static std::string GetWhileExprLabel(int index)
@@ -1305,10 +1675,10 @@ static std::string GetWhileEndLabel(int index)
     return "WHILE_END" + std::to_string(index);
 }
 
-static int GetIfLabelIndex()
+static int GetIfLabelIndex(Context &context)
 {
-    iflabel++;
-    return iflabel;
+    context.ifLabel++;
+    return context.ifLabel;
 }
 
 static std::string GetIfTrueLabel(int index)
@@ -1334,11 +1704,11 @@ public:
 class Statements
 {
 public:
-    static std::unique_ptr<Statements> Compile(Tokenizer *tokenizer);
+    static Statements *Compile(Tokenizer *tokenizer, Arena *arena);
     void GenVMCode(const VMWriter &writer, Context &context);
 
 private:
-    std::vector<std::unique_ptr<Statement>> statements;
+    ArenaList<Statement *> statements;
 };
 
 class LetStatement : public Statement
@@ -1346,13 +1716,13 @@ class LetStatement : public Statement
 public:
     // let varName([expression])?=expression;
     // 'let' has been taken by Statement
-    static std::unique_ptr<LetStatement> Compile(Tokenizer *tokenizer)
+    static LetStatement *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto ret = std::make_unique<LetStatement>();
+        auto ret = arena->New<LetStatement>();
 
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-            ret->varName = tokenizer->GetIdentifier();
+            ret->varName = arena->Intern(tokenizer->GetIdentifier());
         else
             throw "expect an identifier for var name";
 
@@ -1364,7 +1734,7 @@ public:
                 ret->indexExpr = nullptr;
             else if (symbol == '[')
             {
-                ret->indexExpr = Expression::Compile(tokenizer);
+                ret->indexExpr = Expression::Compile(tokenizer, arena);
 
                 ConsumeChar(tokenizer, ']');
 
@@ -1376,7 +1746,7 @@ public:
         else
             throw "expect a symbol - =|[";
 
-        ret->rightExpr = Expression::Compile(tokenizer);
+        ret->rightExpr = Expression::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, ';');
 
@@ -1405,15 +1775,15 @@ public:
         {
             VarKind kind = VarKind::NONE;
             int index = 0;
-            GetPropertyByName(varName, kind, index);
+            GetPropertyByName(context, varName, kind, index);
             writer.WritePop(VarKindToSegment(kind), index);
         }
     }
 
 private:
-    std::string varName;
-    std::unique_ptr<Expression> indexExpr;
-    std::unique_ptr<Expression> rightExpr;
+    std::string_view varName;
+    Expression *indexExpr = nullptr;
+    Expression *rightExpr = nullptr;
 };
 
 class IfStatement : public Statement
@@ -1421,18 +1791,18 @@ class IfStatement : public Statement
 public:
     // if (expression) {statements} (else {statements})?
     // 'if' has been taken by Statement
-    static std::unique_ptr<IfStatement> Compile(Tokenizer *tokenizer)
+    static IfStatement *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto ret = std::make_unique<IfStatement>();
+        auto ret = arena->New<IfStatement>();
         ConsumeChar(tokenizer, '(');
 
-        ret->conditionExpr = Expression::Compile(tokenizer);
+        ret->conditionExpr = Expression::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, ')');
 
         ConsumeChar(tokenizer, '{');
 
-        ret->ifBody = Statements::Compile(tokenizer);
+        ret->ifBody = Statements::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, '}');
 
@@ -1442,7 +1812,7 @@ public:
         {
             ConsumeChar(tokenizer, '{');
 
-            ret->elseBody = Statements::Compile(tokenizer);
+            ret->elseBody = Statements::Compile(tokenizer, arena);
 
             ConsumeChar(tokenizer, '}');
         }
@@ -1457,7 +1827,7 @@ public:
 
     void GenVMCode(const VMWriter &writer, Context &context) override
     {
-        int index = GetIfLabelIndex();
+        int index = GetIfLabelIndex(context);
         auto iflabel = GetIfTrueLabel(index);
         auto elselabel = GetIfFalseLabel(index);
         auto ifend = GetIfEndLabel(index);
@@ -1482,9 +1852,9 @@ public:
     }
 
 private:
-    std::unique_ptr<Expression> conditionExpr;
-    std::unique_ptr<Statements> ifBody;
-    std::unique_ptr<Statements> elseBody;
+    Expression *conditionExpr = nullptr;
+    Statements *ifBody = nullptr;
+    Statements *elseBody = nullptr;
 };
 
 class WhileStatement : public Statement
@@ -1492,19 +1862,19 @@ class WhileStatement : public Statement
 public:
     // while (expression) {statements}
     // 'while' has been taken by Statement
-    static std::unique_ptr<WhileStatement> Compile(Tokenizer *tokenizer)
+    static WhileStatement *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto ret = std::make_unique<WhileStatement>();
+        auto ret = arena->New<WhileStatement>();
 
         ConsumeChar(tokenizer, '(');
 
-        ret->conditionExpr = Expression::Compile(tokenizer);
+        ret->conditionExpr = Expression::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, ')');
 
         ConsumeChar(tokenizer, '{');
 
-        ret->whileBody = Statements::Compile(tokenizer);
+        ret->whileBody = Statements::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, '}');
 
@@ -1513,7 +1883,7 @@ public:
 
     void GenVMCode(const VMWriter &writer, Context &context) override
     {
-        int index = GetWhileLabelIndex();
+        int index = GetWhileLabelIndex(context);
         auto exprlabel = GetWhileExprLabel(index);
         auto endlabel = GetWhileEndLabel(index);
 
@@ -1527,8 +1897,8 @@ public:
     }
 
 private:
-    std::unique_ptr<Expression> conditionExpr;
-    std::unique_ptr<Statements> whileBody;
+    Expression *conditionExpr = nullptr;
+    Statements *whileBody = nullptr;
 };
 
 class DoStatement : public Statement
@@ -1536,10 +1906,10 @@ class DoStatement : public Statement
 public:
     // do subroutineCall;
     // 'do' has been taken by Statement
-    static std::unique_ptr<DoStatement> Compile(Tokenizer *tokenizer)
+    static DoStatement *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto ret = std::make_unique<DoStatement>();
-        ret->subroutineCall = SubroutineCall::Compile(tokenizer);
+        auto ret = arena->New<DoStatement>();
+        ret->subroutineCall = SubroutineCall::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, ';');
 
@@ -1554,16 +1924,16 @@ public:
     }
 
 private:
-    std::unique_ptr<SubroutineCall> subroutineCall;
+    SubroutineCall *subroutineCall = nullptr;
 };
 
 class ReturnsStatement : public Statement
 {
 public:
     // return expression? ;
-    static std::unique_ptr<ReturnsStatement> Compile(Tokenizer *tokenizer)
+    static ReturnsStatement *Compile(Tokenizer *tokenizer, Arena *arena)
     {
-        auto ret = std::make_unique<ReturnsStatement>();
+        auto ret = arena->New<ReturnsStatement>();
 
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::SYMBOL &&
@@ -1572,7 +1942,7 @@ public:
         else
         {
             tokenizer->GoBack();
-            ret->returnExpr = Expression::Compile(tokenizer);
+            ret->returnExpr = Expression::Compile(tokenizer, arena);
 
             ConsumeChar(tokenizer, ';');
         }
@@ -1591,12 +1961,12 @@ public:
     }
 
 private:
-    std::unique_ptr<Expression> returnExpr;
+    Expression *returnExpr = nullptr;
 };
 
-std::unique_ptr<Statements> Statements::Compile(Tokenizer *tokenizer)
+Statements *Statements::Compile(Tokenizer *tokenizer, Arena *arena)
 {
-    auto ret = std::make_unique<Statements>();
+    auto ret = arena->New<Statements>();
 
     while (true)
     {
@@ -1610,19 +1980,19 @@ std::unique_ptr<Statements> Statements::Compile(Tokenizer *tokenizer)
             switch (keyword)
             {
             case KeyWord::LET:
-                ret->statements.push_back(LetStatement::Compile(tokenizer));
+                ret->statements.Add(arena, LetStatement::Compile(tokenizer, arena));
                 continue;
             case KeyWord::IF:
-                ret->statements.push_back(IfStatement::Compile(tokenizer));
+                ret->statements.Add(arena, IfStatement::Compile(tokenizer, arena));
                 continue;
             case KeyWord::WHILE:
-                ret->statements.push_back(WhileStatement::Compile(tokenizer));
+                ret->statements.Add(arena, WhileStatement::Compile(tokenizer, arena));
                 continue;
             case KeyWord::DO:
-                ret->statements.push_back(DoStatement::Compile(tokenizer));
+                ret->statements.Add(arena, DoStatement::Compile(tokenizer, arena));
                 continue;
             case KeyWord::RETURN:
-                ret->statements.push_back(ReturnsStatement::Compile(tokenizer));
+                ret->statements.Add(arena, ReturnsStatement::Compile(tokenizer, arena));
                 continue;
 
             default:
@@ -1648,20 +2018,20 @@ class VarDec
 {
 public:
     // var type varName (, varName)* ;
-    static std::unique_ptr<VarDec> Compile(Tokenizer *tokenizer)
+    static VarDec *Compile(Tokenizer *tokenizer, Arena *arena)
     {
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::KEYWORD &&
             tokenizer->GetKeyWord() == KeyWord::VAR)
         {
-            auto var = std::make_unique<VarDec>();
-            var->type = JackType::Compile(tokenizer);
+            auto var = arena->New<VarDec>();
+            var->type = JackType::Compile(tokenizer, arena);
 
             while (true)
             {
                 tokenizer->Advance();
                 if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-                    var->names.push_back(tokenizer->GetIdentifier());
+                    var->names.Add(arena, arena->Intern(tokenizer->GetIdentifier()));
                 else
                     throw "expect an identifier for var name";
 
@@ -1687,10 +2057,10 @@ public:
         return nullptr;
     }
 
-    void FillVarTable() const
+    void FillVarTable(Context &context) const
     {
         for (auto &&name : names)
-            LocalVariables.Define(name, *(type.get()), VarKind::VAR);
+            context.localVariables.Define(name, *type, VarKind::VAR);
     }
 
     int VarCount() const
@@ -1699,25 +2069,25 @@ public:
     }
 
 private:
-    std::unique_ptr<JackType> type;
-    std::vector<std::string> names;
+    JackType *type = nullptr;
+    ArenaList<std::string_view> names;
 };
 
 class SubroutineBody
 {
 public:
     // '{' varDec* statements '}'
-    static std::unique_ptr<SubroutineBody> Compile(Tokenizer *tokenizer)
+    static SubroutineBody *Compile(Tokenizer *tokenizer, Arena *arena)
     {
         ConsumeChar(tokenizer, '{');
 
-        auto body = std::make_unique<SubroutineBody>();
+        auto body = arena->New<SubroutineBody>();
 
-        std::unique_ptr<VarDec> var = nullptr;
-        while ((var = VarDec::Compile(tokenizer)) != nullptr)
-            body->varDecs.push_back(std::move(var));
+        VarDec *var = nullptr;
+        while ((var = VarDec::Compile(tokenizer, arena)) != nullptr)
+            body->varDecs.Add(arena, var);
 
-        body->statements = Statements::Compile(tokenizer);
+        body->statements = Statements::Compile(tokenizer, arena);
 
         ConsumeChar(tokenizer, '}');
 
@@ -1727,7 +2097,7 @@ public:
     void GenVMCode(const VMWriter &writer, Context &context)
     {
         for (auto &&var : varDecs)
-            var->FillVarTable();
+            var->FillVarTable(context);
 
         if (context.subroutineType == SubroutineType::CONSTRUCTOR)
         {
@@ -1754,8 +2124,8 @@ public:
     }
 
 private:
-    std::vector<std::unique_ptr<VarDec>> varDecs;
-    std::unique_ptr<Statements> statements;
+    ArenaList<VarDec *> varDecs;
+    Statements *statements = nullptr;
 };
 
 static std::string SubroutineTypeToString(SubroutineType type)
@@ -1777,12 +2147,12 @@ class SubroutineDec
 {
 public:
     // (constructor|function|method) type subroutineName '(' parameterList ')' subroutineBody
-    static std::unique_ptr<SubroutineDec> Compile(Tokenizer *tokenizer)
+    static SubroutineDec *Compile(Tokenizer *tokenizer, Arena *arena)
     {
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::KEYWORD)
         {
-            auto dec = std::make_unique<SubroutineDec>();
+            auto dec = arena->New<SubroutineDec>();
             auto keyword = tokenizer->GetKeyWord();
             switch (keyword)
             {
@@ -1799,21 +2169,21 @@ public:
                 goto EXIT;
             }
 
-            dec->returnType = JackType::Compile(tokenizer);
+            dec->returnType = JackType::Compile(tokenizer, arena);
 
             tokenizer->Advance();
             if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-                dec->routineName = tokenizer->GetIdentifier();
+                dec->routineName = arena->Intern(tokenizer->GetIdentifier());
             else
                 throw "expect an identifier for subroutineName";
 
             ConsumeChar(tokenizer, '(');
 
-            dec->parameters = ParameterList::Compile(tokenizer);
+            dec->parameters = ParameterList::Compile(tokenizer, arena);
 
             ConsumeChar(tokenizer, ')');
 
-            dec->subroutineBody = SubroutineBody::Compile(tokenizer);
+            dec->subroutineBody = SubroutineBody::Compile(tokenizer, arena);
 
             return dec;
         }
@@ -1825,12 +2195,12 @@ public:
 
     void GenVMCode(const VMWriter &writer, Context &context)
     {
-        writer.WriteFunction(context.className + "." + routineName, subroutineBody->VarCount());
+        writer.WriteFunction(QualifiedName(context.className, routineName), subroutineBody->VarCount());
 
-        LocalVariables.Reset();
-        ResetLabelIndex();
+        context.localVariables.Reset();
+        ResetLabelIndex(context);
         if (parameters)
-            parameters->FillVarTable();
+            parameters->FillVarTable(context);
 
         context.subroutineType = subroutineType;
 
@@ -1839,40 +2209,40 @@ public:
 
 private:
     SubroutineType subroutineType;
-    std::unique_ptr<JackType> returnType;
-    std::string routineName;
-    std::unique_ptr<ParameterList> parameters;
-    std::unique_ptr<SubroutineBody> subroutineBody;
+    JackType *returnType = nullptr;
+    std::string_view routineName;
+    ParameterList *parameters = nullptr;
+    SubroutineBody *subroutineBody = nullptr;
 };
 
 class JackClass
 {
 public:
     // 'class' className '{' classVarDec* subroutineDec* '}'
-    static std::unique_ptr<JackClass> Compile(Tokenizer *tokenizer)
+    static JackClass *Compile(Tokenizer *tokenizer, Arena *arena)
     {
         tokenizer->Advance();
         if (!(tokenizer->GetTokenType() == TokenType::KEYWORD &&
               tokenizer->GetKeyWord() == KeyWord::CLASS))
             throw "expect a class key word";
 
-        auto jackClass = std::make_unique<JackClass>();
+        auto jackClass = arena->New<JackClass>();
 
         tokenizer->Advance();
         if (tokenizer->GetTokenType() == TokenType::IDENTIFIER)
-            jackClass->className = tokenizer->GetIdentifier();
+            jackClass->className = arena->Intern(tokenizer->GetIdentifier());
         else
             throw "expect an identifier for class name";
 
         ConsumeChar(tokenizer, '{');
 
-        std::unique_ptr<ClassVarDec> varDec = nullptr;
-        while ((varDec = ClassVarDec::Compile(tokenizer)) != nullptr)
-            jackClass->varDecs.push_back(std::move(varDec));
+        ClassVarDec *varDec = nullptr;
+        while ((varDec = ClassVarDec::Compile(tokenizer, arena)) != nullptr)
+            jackClass->varDecs.Add(arena, varDec);
 
-        std::unique_ptr<SubroutineDec> subroutineDec = nullptr;
-        while ((subroutineDec = SubroutineDec::Compile(tokenizer)) != nullptr)
-            jackClass->subroutineDecs.push_back(std::move(subroutineDec));
+        SubroutineDec *subroutineDec = nullptr;
+        while ((subroutineDec = SubroutineDec::Compile(tokenizer, arena)) != nullptr)
+            jackClass->subroutineDecs.Add(arena, subroutineDec);
 
         ConsumeChar(tokenizer, '}');
 
@@ -1881,14 +2251,13 @@ public:
 
     void GenVMCode(const VMWriter &writer)
     {
-        ClassVariables.Reset();
         Context context;
         context.className = className;
 
         int nFields = 0;
         for (auto &&varDec : varDecs)
         {
-            varDec->FillVarTable();
+            varDec->FillVarTable(context);
             nFields += varDec->FieldCount();
         }
 
@@ -1899,20 +2268,143 @@ public:
     }
 
 private:
-    std::string className;
-    std::vector<std::unique_ptr<ClassVarDec>> varDecs;
-    std::vector<std::unique_ptr<SubroutineDec>> subroutineDecs;
+    std::string_view className;
+    ArenaList<ClassVarDec *> varDecs;
+    ArenaList<SubroutineDec *> subroutineDecs;
 };
 
+// a class only depends on its own source, so workers need nothing but the path;
+// the whole AST of the class is released with the arena
+static void CompileClass(std::filesystem::path path)
+{
+    Tokenizer tokenizer(path.string());
+    Arena arena;
+    auto jackClass = JackClass::Compile(&tokenizer, &arena);
+
+    auto filename = path.stem().string();
+    path.replace_filename(filename + ".vm.g");
+    OutputBuffer buffer;
+    VMWriter writer(buffer);
+    jackClass->GenVMCode(writer);
+
+    std::ofstream output(path);
+    buffer.Flush(output);
+    output.close();
+}
+
+#ifdef COUNT_ALLOCATIONS
+// bench.sh builds with -DCOUNT_ALLOCATIONS so that --stats can report heap
+// allocations; the other new and delete forms forward to these
+static std::atomic<size_t> allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto alignment = static_cast<size_t>(align);
+    if (void *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+// freeing what the replacements above malloc'ed is correct even where
+// delete gets inlined next to a new GCC does not see through
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+#pragma GCC diagnostic pop
+#endif
+
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    std::string input;
+    bool tokenize = false;
+    bool stats = false;
+    int repeat = 1;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--tokenize")
+            tokenize = true;
+        else if (arg == "--stats")
+            stats = true;
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--jobs" && i + 1 < argc)
+            jobs = std::max(1, std::stoi(argv[++i]));
+        else if (input.empty())
+            input = arg;
+        else
+        {
+            input.clear();
+            break;
+        }
+    }
+
+    if (input.empty())
     {
-        std::cout << "Usage: /bin /path/to/input/file\n";
+        std::cout << "Usage: /bin [--tokenize] [--stats] [--repeat N] [--jobs N] /path/to/input/file\n";
         return 0;
     }
 
-    std::filesystem::path input_filename(argv[1]);
+    std::filesystem::path input_filename(input);
+
+    // lex only, to measure the tokenizer on its own
+    if (tokenize)
+    {
+        std::vector<std::string> paths;
+        if (std::filesystem::is_directory(input_filename))
+        {
+            for (const auto &entry : std::filesystem::directory_iterator(input_filename))
+            {
+                if (entry.path().extension() == ".jack")
+                    paths.push_back(entry.path().string());
+            }
+        }
+        else
+            paths.push_back(input_filename.string());
+
+        size_t count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < repeat; run++)
+        {
+            for (const auto &path : paths)
+            {
+                Tokenizer tokenizer(path);
+                count += tokenizer.TokenCount();
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << count << " tokens in " << elapsed.count() << " s, "
+                  << count / elapsed.count() / 1e6 << " M tokens/s\n";
+        return 0;
+    }
 
     std::filesystem::path dir;
     if (std::filesystem::is_directory(input_filename)) // dir
@@ -1924,20 +2416,42 @@ int main(int argc, char *argv[])
         dir = input_filename.parent_path();
     }
 
+#ifdef COUNT_ALLOCATIONS
+    size_t startAllocations = allocations;
+#endif
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::filesystem::path> paths;
     for (const auto &entry : std::filesystem::directory_iterator(dir))
     {
-        auto path = entry.path();
-        if (path.extension() != ".jack")
-            continue;
+        if (entry.path().extension() == ".jack")
+            paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
 
-        Tokenizer tokenizer(path.string());
-        auto jackClass = JackClass::Compile(&tokenizer);
+    // workers take the next class in sorted order until none is left
+    std::atomic<size_t> next = 0;
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < paths.size(); i = next++)
+            CompileClass(paths[i]);
+    };
 
-        auto filename = path.stem().string();
-        path.replace_filename(filename + ".vm.g");
-        std::ofstream output(path);
-        VMWriter writer(output);
-        jackClass->GenVMCode(writer);
-        output.close();
+    jobs = std::min(jobs, std::max(1, static_cast<int>(paths.size())));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < jobs; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+
+    if (stats)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << paths.size() << " classes on " << jobs << " jobs in " << elapsed.count() << " s";
+#ifdef COUNT_ALLOCATIONS
+        std::cout << ", " << allocations - startAllocations << " allocations";
+#endif
+        std::cout << "\n";
     }
 }
@@ -1,4 +1,4 @@
-g++ --std=c++17 -g compiler.cc -o compiler
+g++ --std=c++17 -g -pthread compiler.cc -o compiler
 
 rm Seven/Main.vm.g
 rm ConvertToBin/Main.vm.g